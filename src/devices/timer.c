@@ -31,23 +31,71 @@ static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
-// edited by choi
-static struct list sleep_list;
-
-static bool comp_tick (const struct list_elem *a,
-											 const struct list_elem *b,
-											 void *aux);
-
-static void timer_wakeup (void);
+/* Sleeping threads, in a hierarchical timing wheel indexed by
+   the tick they wake up at.  Level 0 has one slot per tick for
+   the next WHEEL0_SIZE ticks.  Each level 1 slot covers
+   WHEEL0_SIZE ticks, up to WHEEL0_SIZE * WHEEL1_SIZE ticks ahead,
+   and is moved down to level 0 when its turn comes.  Later
+   wakeups wait in wheel_overflow, which is looked at once per
+   turn of level 1.  Sleeping and waking are O(1) and the timer
+   interrupt only touches the slot that expires. */
+#define WHEEL0_BITS 8
+#define WHEEL0_SIZE (1 << WHEEL0_BITS)
+#define WHEEL1_BITS 6
+#define WHEEL1_SIZE (1 << WHEEL1_BITS)
+#define WHEEL_SPAN (WHEEL0_SIZE * WHEEL1_SIZE)
+
+static struct list wheel0[WHEEL0_SIZE];
+static struct list wheel1[WHEEL1_SIZE];
+static struct list wheel_overflow;
+
+static void wheel_insert (struct thread *, int64_t now);
+static void wheel_cascade (struct list *, int64_t now);
+static void timer_wakeup (int64_t now);
+
+/* The PIT runs in one-shot mode and is programmed for the next
+   event: normally the next tick, earlier if a sub-tick sleeper
+   is due, and later while the idle thread runs and no sleeper
+   wakes up in the meantime ("tickless idle").  Time is kept in
+   PIT cycles since boot. */
+#define PIT_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+static int64_t pit_base;        /* PIT cycles when last programmed. */
+static uint16_t pit_count;      /* Count it was programmed with. */
+static int64_t next_tick;       /* PIT cycles at the next tick. */
+static bool timer_idling;       /* Skipping ticks for the idle thread? */
+static int64_t idle_interrupts; /* # of timer interrupts skipped. */
+
+/* Threads in timer_hrsleep(), ordered by wakeup time in PIT
+   cycles.  Sleeps that short are few at a time. */
+static struct list hr_list;
+
+static int64_t timer_cycles (void);
+static void timer_advance (void);
+static void timer_program (void);
+static void timer_hrsleep (int64_t cycles);
+static bool hr_less (const struct list_elem *, const struct list_elem *,
+                     void *aux);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void) 
 {
-  pit_configure_channel (0, 2, TIMER_FREQ);
+	int i;
+
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-	list_init (&sleep_list);
+
+	for (i = 0; i < WHEEL0_SIZE; i++)
+		list_init (&wheel0[i]);
+	for (i = 0; i < WHEEL1_SIZE; i++)
+		list_init (&wheel1[i]);
+	list_init (&wheel_overflow);
+	list_init (&hr_list);
+
+	pit_base = 0;
+	next_tick = PIT_TICK;
+	timer_program ();
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -101,42 +149,222 @@ timer_elapsed (int64_t then)
 void
 timer_sleep (int64_t ticks) 
 {
-//	int64_t start = timer_ticks ();
 	enum intr_level old_level;
+	int64_t now;
   ASSERT (intr_get_level () == INTR_ON);
 
-	thread_current ()->t_ticks = timer_ticks () + ticks;
+	if (ticks <= 0)
+		return;
 
+	//Read the time with interrupts off, so that the slot can not expire
 	old_level = intr_disable();
-	list_insert_ordered (&sleep_list, &thread_current ()->elem,
-											 &comp_tick, NULL);
+	now = timer_ticks ();
+	thread_current ()->t_ticks = now + ticks;
+	wheel_insert (thread_current (), now);
 	thread_block ();
 	intr_set_level (old_level);
-//	while(timer_elapsed (start) > ticks)
-//			thread_yield();
 }
 
-static bool
-comp_tick (const struct list_elem *a, const struct list_elem *b,
-					 void *aux UNUSED)
+/* Puts sleeping thread T in the slot of the timing wheel for its
+   wakeup tick T->t_ticks, which must not be before NOW. */
+static void
+wheel_insert (struct thread *t, int64_t now)
+{
+	int64_t delta = t->t_ticks - now;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (delta >= 0);
+
+	if (delta < WHEEL0_SIZE)
+		list_push_back (&wheel0[t->t_ticks & (WHEEL0_SIZE - 1)], &t->elem);
+	else if (delta < WHEEL_SPAN)
+		list_push_back (&wheel1[(t->t_ticks >> WHEEL0_BITS) & (WHEEL1_SIZE - 1)],
+										&t->elem);
+	else
+		list_push_back (&wheel_overflow, &t->elem);
+}
+
+/* Moves the threads in SLOT to the slots where they belong now
+   that it is tick NOW. */
+static void
+wheel_cascade (struct list *slot, int64_t now)
+{
+	struct list moving;
+
+	//A thread can go back to SLOT, so empty it first
+	list_init (&moving);
+	while (!list_empty (slot))
+		list_push_back (&moving, list_pop_front (slot));
+
+	while (!list_empty (&moving))
+		wheel_insert (list_entry (list_pop_front (&moving), struct thread, elem),
+									now);
+}
+
+/* Wakes up the threads whose wakeup tick is NOW.  Runs in the
+   timer interrupt. */
+static void
+timer_wakeup (int64_t now)
 {
-	struct thread *x = list_entry (a, struct thread, elem);
-	struct thread *y = list_entry (b, struct thread, elem);
-	return x->t_ticks < y->t_ticks;
+	struct list *slot = &wheel0[now & (WHEEL0_SIZE - 1)];
+
+	if ((now & (WHEEL0_SIZE - 1)) == 0)
+	{
+		if ((now & (WHEEL_SPAN - 1)) == 0)
+			wheel_cascade (&wheel_overflow, now);
+		wheel_cascade (&wheel1[(now >> WHEEL0_BITS) & (WHEEL1_SIZE - 1)], now);
+	}
+
+	while (!list_empty (slot))
+		thread_unblock (list_entry (list_pop_front (slot), struct thread, elem));
+}
+/* Returns the PIT cycles since boot.  Interrupts must be off. */
+static int64_t
+timer_cycles (void)
+{
+	/* The counter wraps around to 0xffff after the interrupt, the
+	   16-bit difference stays right until the next wrap. */
+	uint16_t elapsed = pit_count - pit_read_counter (0);
+	return pit_base + elapsed;
 }
 
+/* Brings the time up to date, runs the ticks that passed since
+   the PIT was programmed, wakes up the sub-tick sleepers that are
+   due and programs the PIT for the next event. */
 static void
-timer_wakeup(void)
+timer_advance (void)
 {
-	struct thread *sleeping_thread UNUSED;
+	int64_t n = 0;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	pit_base = timer_cycles ();
+	while (pit_base >= next_tick)
+	{
+		next_tick += PIT_TICK;
+		ticks++;
+		timer_wakeup (ticks);
+		thread_tick ();
+		n++;
+	}
+	if (n > 1)
+		idle_interrupts += n - 1;
+
+	while (!list_empty (&hr_list)
+				 && list_entry (list_front (&hr_list), struct thread, elem)->t_ticks
+				    <= pit_base)
+		thread_unblock (list_entry (list_pop_front (&hr_list), struct thread, elem));
+
+	timer_program ();
+}
 
-	while (!list_empty (&sleep_list)&& 
-					list_entry (list_front (&sleep_list), 
-					struct thread, elem)->t_ticks <= timer_ticks ())
+/* Programs the PIT for the next event after pit_base, which must
+   be up to date. */
+static void
+timer_program (void)
+{
+	int64_t deadline = next_tick;
+
+	//While idle, skip the ticks in which no sleeper wakes up
+	if (timer_idling)
+	{
+		int64_t tick = ticks + 1;
+		while (list_empty (&wheel0[tick & (WHEEL0_SIZE - 1)])
+					 && ((tick + 1) & (WHEEL0_SIZE - 1)) != 0
+					 && deadline + PIT_TICK - pit_base <= UINT16_MAX)
 		{
-			thread_unblock (list_entry (list_pop_front (&sleep_list), struct thread, elem));
+			tick++;
+			deadline += PIT_TICK;
 		}
+	}
+
+	if (!list_empty (&hr_list)
+			&& list_entry (list_front (&hr_list), struct thread, elem)->t_ticks
+			   < deadline)
+		deadline = list_entry (list_front (&hr_list), struct thread, elem)->t_ticks;
+
+	if (deadline - pit_base < 1)
+		pit_count = 1;
+	else if (deadline - pit_base > UINT16_MAX)
+		pit_count = UINT16_MAX;
+	else
+		pit_count = deadline - pit_base;
+	pit_oneshot (0, pit_count);
 }
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  Lets the timer skip the ticks in which nothing
+   is due. */
+void
+timer_idle_enter (void)
+{
+	int64_t now;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	//The interrupt is due anyway
+	now = timer_cycles ();
+	if (now >= pit_base + pit_count)
+		return;
+
+	timer_idling = true;
+	pit_base = now;
+	timer_program ();
+}
+
+/* Called by the idle thread after any interrupt woke it up.  If
+   it was not the timer, runs the ticks skipped so far and goes
+   back to one interrupt per tick. */
+void
+timer_idle_exit (void)
+{
+	enum intr_level old_level = intr_disable ();
+
+	if (timer_idling)
+	{
+		timer_idling = false;
+		//If the interrupt is pending, timer_interrupt() does the rest
+		if (timer_cycles () < pit_base + pit_count)
+			timer_advance ();
+	}
+	intr_set_level (old_level);
+}
+
+/* Sleeps for CYCLES PIT cycles, less than a tick, by programming
+   the PIT for the wakeup instead of busy waiting. */
+static void
+timer_hrsleep (int64_t cycles)
+{
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+	int64_t now;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	old_level = intr_disable ();
+	now = timer_cycles ();
+	t->t_ticks = now + cycles;
+	list_insert_ordered (&hr_list, &t->elem, hr_less, NULL);
+
+	//Wake up earlier than the PIT is programmed for
+	if (t->t_ticks < pit_base + pit_count)
+	{
+		pit_base = now;
+		timer_program ();
+	}
+	thread_block ();
+	intr_set_level (old_level);
+}
+
+/* Orders threads in hr_list by wakeup time. */
+static bool
+hr_less (const struct list_elem *a, const struct list_elem *b,
+				 void *aux UNUSED)
+{
+	return (list_entry (a, struct thread, elem)->t_ticks
+					< list_entry (b, struct thread, elem)->t_ticks);
+}
+
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
    turned on. */
 void
@@ -205,15 +433,16 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" interrupts skipped while idle\n",
+          idle_interrupts);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-	timer_wakeup ();
-  thread_tick ();
+	timer_idling = false;
+	timer_advance ();
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -271,9 +500,11 @@ real_time_sleep (int64_t num, int32_t denom)
     }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      /* Otherwise, program the timer for the sub-tick wakeup.
+         NUM is less than a tick here, so this cannot overflow. */
+      int64_t cycles = num * PIT_HZ / denom;
+      if (cycles > 0)
+        timer_hrsleep (cycles);
     }
 }
 
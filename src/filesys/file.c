@@ -84,6 +84,16 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
   return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads SIZE bytes from FILE into KPAGE, a page of kernel
+   memory, starting at offset FILE_OFS, which must be sector
+   aligned.  See inode_read_page().  Returns the number of bytes
+   actually read.  The file's current position is unaffected. */
+off_t
+file_read_page (struct file *file, void *kpage, off_t size, off_t file_ofs) 
+{
+  return inode_read_page (file->inode, kpage, size, file_ofs);
+}
+
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
@@ -5,7 +5,10 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -37,8 +40,16 @@ struct inode
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
     struct inode_disk data;             /* Inode content. */
+    struct lock lock;                   /* Protects `removed' and
+                                           `deny_write_cnt', serializes
+                                           writes. */
+    struct rwlock dir_lock;             /* Directory lookups and updates. */
+    void *cache;                        /* See inode_set_cache(). */
+    void (*cache_free) (void *);        /* Releases `cache'. */
   };
 
+static void inode_drop_cache (struct inode *);
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -57,11 +68,18 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes.  Opening an inode that is already open
+   only reads the list, so it does not exclude other openers. */
+static struct rwlock open_inodes_lock;
+
+static struct inode *inode_lookup (block_sector_t);
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  rwlock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -111,20 +129,14 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *open;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_acquire_read (&open_inodes_lock);
+  inode = inode_reopen (inode_lookup (sector));
+  rwlock_release_read (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
@@ -132,21 +144,60 @@ inode_open (block_sector_t sector)
     return NULL;
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  lock_init (&inode->lock);
+  rwlock_init (&inode->dir_lock);
+  inode->cache = NULL;
   block_read (fs_device, inode->sector, &inode->data);
+
+  /* Someone else may have opened it while we were reading. */
+  rwlock_acquire_write (&open_inodes_lock);
+  open = inode_reopen (inode_lookup (sector));
+  if (open == NULL)
+    list_push_front (&open_inodes, &inode->elem);
+  rwlock_release_write (&open_inodes_lock);
+
+  if (open != NULL)
+    {
+      free (inode);
+      return open;
+    }
   return inode;
 }
 
+/* Returns the open inode for SECTOR, or a null pointer if it is
+   not open.  open_inodes_lock must be held. */
+static struct inode *
+inode_lookup (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode;
+    }
+  return NULL;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode)
 {
+  enum intr_level old_level;
+
+  /* Other readers of open_inodes may reopen it at the same time. */
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      old_level = intr_disable ();
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   return inode;
 }
 
@@ -163,16 +214,28 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  enum intr_level old_level;
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.  Holding the
+     lock for writing keeps it from being reopened meanwhile. */
+  rwlock_acquire_write (&open_inodes_lock);
+  old_level = intr_disable ();
+  last = --inode->open_cnt == 0;
+  intr_set_level (old_level);
+  if (last)
     {
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
- 
+    }
+  rwlock_release_write (&open_inodes_lock);
+
+  if (last)
+    {
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
@@ -181,6 +244,7 @@ inode_close (struct inode *inode)
                             bytes_to_sectors (inode->data.length)); 
         }
 
+      inode_drop_cache (inode);
       free (inode); 
     }
 }
@@ -191,12 +255,18 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+
+  lock_acquire (&inode->lock);
   inode->removed = true;
+  lock_release (&inode->lock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
+   than SIZE if an error occurs or end of file is reached.
+
+   Reads take no lock: inodes do not grow, and the block device
+   reads and writes whole sectors atomically. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
@@ -249,11 +319,44 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   return bytes_read;
 }
 
+/* Reads SIZE bytes from INODE into KPAGE, a page of kernel
+   memory, starting at OFFSET, which must be sector aligned.
+   Unlike inode_read_at(), whole sectors are read straight into
+   KPAGE, including the last one, so no byte is copied twice; the
+   bytes after SIZE in that sector are cleared.  Returns the
+   number of bytes actually read, which may be less than SIZE if
+   end of file is reached. */
+off_t
+inode_read_page (struct inode *inode, void *kpage, off_t size, off_t offset)
+{
+  uint8_t *page = kpage;
+  off_t length = inode_length (inode);
+  off_t bytes_read;
+
+  ASSERT (offset % BLOCK_SECTOR_SIZE == 0);
+  ASSERT (size <= PGSIZE);
+
+  if (offset >= length)
+    return 0;
+  if (size > length - offset)
+    size = length - offset;
+
+  for (bytes_read = 0; bytes_read < size; bytes_read += BLOCK_SECTOR_SIZE)
+    block_read (fs_device, byte_to_sector (inode, offset + bytes_read),
+                page + bytes_read);
+  memset (page + size, 0, bytes_read - size);
+
+  return size;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
    (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   growth is not yet implemented.)
+
+   Writes to an inode are serialized, so that two partial writes
+   to a sector do not undo each other. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
@@ -262,8 +365,13 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   off_t bytes_written = 0;
   uint8_t *bounce = NULL;
 
+  lock_acquire (&inode->lock);
   if (inode->deny_write_cnt)
-    return 0;
+    {
+      lock_release (&inode->lock);
+      return 0;
+    }
+  inode_drop_cache (inode);
 
   while (size > 0) 
     {
@@ -312,6 +420,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       offset += chunk_size;
       bytes_written += chunk_size;
     }
+  lock_release (&inode->lock);
   free (bounce);
 
   return bytes_written;
@@ -322,8 +431,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +443,65 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&inode->lock);
+}
+
+/* Returns the lock of directory INODE, which directory.c holds
+   for reading to look up entries and for writing to change them.
+   It is independent of the lock inode_write_at() takes. */
+struct rwlock *
+inode_dir_lock (struct inode *inode)
+{
+  return &inode->dir_lock;
+}
+
+/* Returns the data attached to INODE by inode_set_cache(), or a
+   null pointer if there is none.  The data stays valid as long
+   as the caller keeps INODE open and denies writes to it. */
+void *
+inode_get_cache (struct inode *inode)
+{
+  void *cache;
+
+  lock_acquire (&inode->lock);
+  cache = inode->cache;
+  lock_release (&inode->lock);
+  return cache;
+}
+
+/* Attaches DATA, derived from the contents of INODE, to INODE,
+   unless other data is attached already.  FREE releases DATA
+   when INODE is written to or closed for the last time.  Returns
+   the data that is attached to INODE afterward. */
+void *
+inode_set_cache (struct inode *inode, void *data, void (*free) (void *))
+{
+  void *cache;
+
+  lock_acquire (&inode->lock);
+  if (inode->cache == NULL)
+    {
+      inode->cache = data;
+      inode->cache_free = free;
+    }
+  cache = inode->cache;
+  lock_release (&inode->lock);
+  return cache;
+}
+
+/* Releases the data attached to INODE, if any. */
+static void
+inode_drop_cache (struct inode *inode)
+{
+  if (inode->cache != NULL)
+    {
+      inode->cache_free (inode->cache);
+      inode->cache = NULL;
+    }
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -0,0 +1,176 @@
+#include <lzf.h>
+#include <debug.h>
+#include <string.h>
+
+/* Longest literal run, farthest and longest back reference
+   that the format can encode. */
+#define LZF_MAX_LIT (1 << 5)
+#define LZF_MAX_OFF (1 << 13)
+#define LZF_MAX_REF ((1 << 8) + (1 << 3))
+
+/* Hashes the 3 bytes at P into a table index. */
+static inline unsigned
+lzf_hash (const uint8_t *p) 
+{
+  uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+  return ((v * 2654435761u) >> (32 - LZF_HASH_BITS))
+         & ((1 << LZF_HASH_BITS) - 1);
+}
+
+/* Compresses IN_LEN bytes from IN into at most OUT_LEN bytes at
+   OUT, using WORK (LZF_WORK_SIZE bytes) as scratch space.
+   Returns the size of the compressed data, or 0 if it did not
+   fit in OUT_LEN bytes, in which case the caller should store
+   the data uncompressed.  IN_LEN must be less than 65535. */
+size_t
+lzf_compress (const void *in_, size_t in_len,
+              void *out_, size_t out_len, void *work) 
+{
+  const uint8_t *in = in_;
+  const uint8_t *ip = in;
+  const uint8_t *in_end = in + in_len;
+  uint8_t *out = out_;
+  uint8_t *op = out;
+  uint8_t *out_end = out + out_len;
+  uint16_t *htab = work;
+  uint8_t *lit_ctrl;
+  size_t lit;
+
+  ASSERT (in_len < UINT16_MAX);
+
+  if (in_len == 0 || out_len == 0)
+    return 0;
+  memset (htab, 0, LZF_WORK_SIZE);
+
+  /* Reserve the control byte of the first literal run. */
+  lit_ctrl = op++;
+  lit = 0;
+
+  while (ip < in_end) 
+    {
+      if (ip + 2 < in_end) 
+        {
+          /* Table entries hold position + 1, so 0 means empty. */
+          unsigned h = lzf_hash (ip);
+          size_t cand = htab[h];
+          htab[h] = ip - in + 1;
+
+          if (cand != 0) 
+            {
+              const uint8_t *ref = in + cand - 1;
+              size_t off = ip - ref - 1;
+
+              if (off < LZF_MAX_OFF
+                  && ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2]) 
+                {
+                  size_t max_len = in_end - ip;
+                  size_t len = 3;
+
+                  if (max_len > LZF_MAX_REF)
+                    max_len = LZF_MAX_REF;
+                  while (len < max_len && ref[len] == ip[len])
+                    len++;
+
+                  /* Close the pending literal run, dropping its
+                     control byte if it is empty. */
+                  if (lit == 0)
+                    op--;
+                  else
+                    *lit_ctrl = lit - 1;
+
+                  if (op + 3 >= out_end)
+                    return 0;
+                  if (len - 2 < 7)
+                    *op++ = (off >> 8) + ((len - 2) << 5);
+                  else 
+                    {
+                      *op++ = (off >> 8) + (7 << 5);
+                      *op++ = len - 2 - 7;
+                    }
+                  *op++ = off;
+                  ip += len;
+
+                  /* Start a new literal run. */
+                  lit_ctrl = op++;
+                  lit = 0;
+                  continue;
+                }
+            }
+        }
+
+      /* Copy one literal byte. */
+      if (op >= out_end)
+        return 0;
+      *op++ = *ip++;
+      if (++lit == LZF_MAX_LIT) 
+        {
+          *lit_ctrl = lit - 1;
+          if (op >= out_end)
+            return 0;
+          lit_ctrl = op++;
+          lit = 0;
+        }
+    }
+
+  if (lit == 0)
+    op--;
+  else
+    *lit_ctrl = lit - 1;
+
+  return op - out;
+}
+
+/* Decompresses IN_LEN bytes of data produced by lzf_compress()
+   from IN into at most OUT_LEN bytes at OUT.
+   Returns the size of the decompressed data, or 0 if the data is
+   corrupt or does not fit in OUT_LEN bytes. */
+size_t
+lzf_decompress (const void *in_, size_t in_len, void *out_, size_t out_len) 
+{
+  const uint8_t *ip = in_;
+  const uint8_t *in_end = ip + in_len;
+  uint8_t *out = out_;
+  uint8_t *op = out;
+  uint8_t *out_end = out + out_len;
+
+  while (ip < in_end) 
+    {
+      unsigned ctrl = *ip++;
+      size_t len;
+
+      if (ctrl < LZF_MAX_LIT) 
+        {
+          /* Literal run. */
+          len = ctrl + 1;
+          if (ip + len > in_end || op + len > out_end)
+            return 0;
+          memcpy (op, ip, len);
+          ip += len;
+          op += len;
+        }
+      else 
+        {
+          /* Back reference, which may overlap its own output. */
+          const uint8_t *ref;
+
+          len = ctrl >> 5;
+          if (len == 7) 
+            {
+              if (ip >= in_end)
+                return 0;
+              len += *ip++;
+            }
+          len += 2;
+
+          if (ip >= in_end)
+            return 0;
+          ref = op - ((ctrl & 0x1f) << 8) - *ip++ - 1;
+          if (ref < out || op + len > out_end)
+            return 0;
+          while (len-- > 0)
+            *op++ = *ref++;
+        }
+    }
+
+  return op - out;
+}
@@ -0,0 +1,29 @@
+#ifndef __LIB_LZF_H
+#define __LIB_LZF_H
+
+/* LZF-style compression.  A fast, byte-oriented LZ77 variant
+   that trades compression ratio for speed, in the spirit of
+   Marc Lehmann's liblzf.  The encoded stream is a sequence of:
+
+     - Literal runs: a control byte 000LLLLL followed by L + 1
+       bytes copied verbatim.
+
+     - Back references: a control byte LLLooooo (LLL != 0),
+       followed by an extra length byte if LLL == 7, followed by
+       the low 8 bits of the offset.  The match is LLL (plus the
+       extra byte) + 2 bytes long and starts offset + 1 bytes
+       back in the output. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of the scratch buffer that lzf_compress() needs. */
+#define LZF_HASH_BITS 12
+#define LZF_WORK_SIZE ((1 << LZF_HASH_BITS) * sizeof (uint16_t))
+
+size_t lzf_compress (const void *in, size_t in_len,
+                     void *out, size_t out_len, void *work);
+size_t lzf_decompress (const void *in, size_t in_len,
+                       void *out, size_t out_len);
+
+#endif /* lib/lzf.h */
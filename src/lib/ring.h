@@ -0,0 +1,61 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+/* Submission and completion rings, shared by the kernel and by
+   user programs through the "submit" system call.
+
+   A process queues file system calls in the submission queue,
+   then a single "submit" system call runs them in order and
+   posts one completion for each.  The indices run freely and are
+   masked with RING_MASK to index the arrays: a queue is empty
+   when its head equals its tail and full when they are
+   RING_SIZE apart.  The process writes sq_tail and cq_head, the
+   kernel writes sq_head and cq_tail. */
+
+#include <stdint.h>
+
+/* Number of entries in each queue, a power of 2. */
+#define RING_SIZE 32
+#define RING_MASK (RING_SIZE - 1)
+
+/* Operations, each one works like the system call of the same
+   name. */
+enum ring_op
+  {
+    RING_READ,                  /* read (fd, buf, len). */
+    RING_WRITE,                 /* write (fd, buf, len). */
+    RING_SEEK,                  /* seek (fd, len). */
+    RING_OPEN,                  /* open (buf), a file name. */
+    RING_CLOSE                  /* close (fd). */
+  };
+
+/* Submission queue entry. */
+struct ring_sqe
+  {
+    int op;                     /* Operation (ring_op). */
+    int fd;                     /* File descriptor. */
+    void *buf;                  /* Buffer or file name. */
+    unsigned len;               /* Length or position. */
+    uint32_t user_data;         /* Copied to the completion. */
+  };
+
+/* Completion queue entry. */
+struct ring_cqe
+  {
+    uint32_t user_data;         /* From the submission. */
+    int res;                    /* What the system call returned, or
+                                   0 for seek and close. */
+  };
+
+/* The rings, in the memory of the process. */
+struct ring
+  {
+    unsigned sq_head;           /* Next submission the kernel runs. */
+    unsigned sq_tail;           /* Next free submission. */
+    unsigned cq_head;           /* Next completion the process reaps. */
+    unsigned cq_tail;           /* Next free completion. */
+    struct ring_sqe sq[RING_SIZE];
+    struct ring_cqe cq[RING_SIZE];
+  };
+
+#endif /* lib/ring.h */
@@ -0,0 +1,39 @@
+#ifndef __LIB_SCHEDSTAT_H
+#define __LIB_SCHEDSTAT_H
+
+/* Scheduler statistics, shared by the kernel and by user
+   programs through the "schedstat" system call. */
+
+#include <stdint.h>
+
+/* Why a thread stopped running. */
+enum sched_reason
+  {
+    SCHED_BLOCK,                /* Blocked, e.g. on a lock. */
+    SCHED_YIELD,                /* Called thread_yield(). */
+    SCHED_PREEMPT,              /* Preempted by an interrupt. */
+    SCHED_EXIT                  /* Exited. */
+  };
+
+/* One context switch in the trace. */
+struct sched_event
+  {
+    int from;                   /* Thread that stopped running. */
+    int to;                     /* Thread that runs next. */
+    int reason;                 /* Why FROM stopped (sched_reason). */
+    uint64_t tsc;               /* Time stamp counter at the switch. */
+  };
+
+/* Per-thread accounting, in time stamp counter cycles. */
+struct sched_thread_stat
+  {
+    uint64_t run_cycles;        /* Time spent running. */
+    uint64_t wait_cycles;       /* Time spent ready, waiting for the CPU. */
+    unsigned voluntary;         /* # of switches by blocking or yielding. */
+    unsigned involuntary;       /* # of switches by preemption. */
+  };
+
+/* Number of events the kernel keeps in its trace. */
+#define SCHED_TRACE_SIZE 128
+
+#endif /* lib/schedstat.h */
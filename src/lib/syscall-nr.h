@@ -28,7 +28,16 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_VMSTAT,                 /* Reads the VM statistics. */
+    SYS_SCHEDSTAT,              /* Reads the scheduler statistics. */
+    SYS_SUBMIT,                 /* Runs the queued calls of a ring. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read from a file into a vector. */
+    SYS_WRITEV                  /* Write to a file from a vector. */
   };
 
 #endif /* lib/syscall-nr.h */
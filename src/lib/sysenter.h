@@ -0,0 +1,40 @@
+#ifndef __LIB_SYSENTER_H
+#define __LIB_SYSENTER_H
+
+/* Fast system call entry with SYSENTER and SYSEXIT, shared by
+   the kernel, which enables it, and by the user system call
+   stubs, which use it when it is there.  See [IA32-v2b]
+   "SYSENTER--Fast System Call".
+
+   The stub stores the address of the system call number, that
+   is its stack pointer, in ECX and the address to return to in
+   EDX before SYSENTER; the kernel returns with SYSEXIT, which
+   takes them from the same registers. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* CPUID leaf 1 EDX flag for SYSENTER and SYSEXIT. */
+#define CPUID_SEP (1u << 11)
+
+/* Returns true if the CPU has SYSENTER and SYSEXIT.  The first
+   Pentium Pro steppings set the flag without having them. */
+static inline bool
+sysenter_supported (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  if ((edx & CPUID_SEP) == 0)
+    return false;
+
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return !(family == 6 && model < 3 && stepping < 3);
+}
+
+#endif /* lib/sysenter.h */
@@ -0,0 +1,19 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+/* Scatter/gather vectors, shared by the kernel and by user
+   programs through the "readv" and "writev" system calls. */
+
+#include <stddef.h>
+
+/* Most vectors that one call takes. */
+#define IOV_MAX 16
+
+/* One buffer of a vector. */
+struct iovec
+  {
+    void *iov_base;             /* Start of the buffer. */
+    size_t iov_len;             /* Length of the buffer in bytes. */
+  };
+
+#endif /* lib/uio.h */
@@ -0,0 +1,45 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Virtual memory statistics, shared by the kernel and by user
+   programs through the "vmstat" system call. */
+
+#include <stdint.h>
+
+/* Kinds of events that are counted and timed. */
+enum vmstat_type
+  {
+    VMSTAT_STACK,               /* Stack growth fault. */
+    VMSTAT_FILE,                /* Lazy load of an executable page. */
+    VMSTAT_ZERO,                /* Bss or stack page filled with zeros. */
+    VMSTAT_MMAP,                /* Lazy load of a memory mapped page. */
+    VMSTAT_SWAP_IN,             /* Page read back from the swap disk. */
+    VMSTAT_ZSWAP_IN,            /* Page read back from the zswap cache. */
+    VMSTAT_EVICT,               /* Frame eviction, all of it. */
+    VMSTAT_SWAP_OUT,            /* Page written to the swap disk. */
+    VMSTAT_ZSWAP_OUT,           /* Page compressed into the zswap cache. */
+    VMSTAT_WRITEBACK,           /* Dirty mmap page written to its file. */
+    VMSTAT_CNT                  /* Number of event kinds. */
+  };
+
+/* Latency histogram buckets.  Bucket I counts the events that
+   took between 2**I and 2**(I+1) - 1 TSC cycles, the last one
+   also counts everything slower. */
+#define VMSTAT_BUCKETS 32
+
+/* Statistics for one kind of event. */
+struct vmstat_entry
+  {
+    uint64_t count;             /* Number of events. */
+    uint64_t cycles;            /* Total TSC cycles spent. */
+    uint64_t max;               /* Slowest event, in TSC cycles. */
+    uint32_t hist[VMSTAT_BUCKETS]; /* Latency histogram. */
+  };
+
+/* What the "vmstat" system call fills in. */
+struct vmstat
+  {
+    struct vmstat_entry entries[VMSTAT_CNT];
+  };
+
+#endif /* lib/vmstat.h */
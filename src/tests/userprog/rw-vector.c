@@ -0,0 +1,53 @@
+/* Writes a file with "writev", then checks that "pread" and
+   "pwrite" do not move the file position and that "readv"
+   reads the file back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample - 1];
+  struct iovec iov[3];
+  size_t size = sizeof buf, third = size / 3;
+  int handle;
+
+  CHECK (create ("vector.txt", size), "create \"vector.txt\"");
+  CHECK ((handle = open ("vector.txt")) > 1, "open \"vector.txt\"");
+
+  /* Write the sample in three pieces. */
+  iov[0].iov_base = (char *) sample;
+  iov[0].iov_len = third;
+  iov[1].iov_base = (char *) sample + third;
+  iov[1].iov_len = third;
+  iov[2].iov_base = (char *) sample + 2 * third;
+  iov[2].iov_len = size - 2 * third;
+  if (writev (handle, iov, 3) != (int) size)
+    fail ("writev was short");
+  msg ("writev");
+
+  /* Positional accesses leave the position at the end. */
+  memset (buf, 0, size);
+  if (pread (handle, buf, 10, 5) != 10 || memcmp (buf, sample + 5, 10))
+    fail ("pread read different data");
+  if (pwrite (handle, sample + 5, 10, 5) != 10)
+    fail ("pwrite was short");
+  if (tell (handle) != size)
+    fail ("position moved to %u", tell (handle));
+  msg ("pread and pwrite");
+
+  /* Read it back in different pieces. */
+  memset (buf, 0, size);
+  seek (handle, 0);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 1;
+  iov[1].iov_base = buf + 1;
+  iov[1].iov_len = size - 1;
+  if (readv (handle, iov, 2) != (int) size || memcmp (buf, sample, size))
+    fail ("readv read different data");
+  msg ("readv");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rw-vector) begin
+(rw-vector) create "vector.txt"
+(rw-vector) open "vector.txt"
+(rw-vector) writev
+(rw-vector) pread and pwrite
+(rw-vector) readv
+(rw-vector) end
+rw-vector: exit(0)
+EOF
+pass;
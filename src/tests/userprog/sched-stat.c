@@ -0,0 +1,56 @@
+/* Runs a child process and checks what the "schedstat" system
+   call reports: the accounting of this process, and a trace
+   that holds the child's exit.  Also checks that the trace is
+   clamped to SCHED_TRACE_SIZE events and that a null EVENTS
+   buffer copies none. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct sched_event events[SCHED_TRACE_SIZE + 1];
+
+void
+test_main (void)
+{
+  struct sched_thread_stat before, after;
+  pid_t child;
+  int i, n;
+  bool exited;
+
+  CHECK (schedstat (&before, NULL, SCHED_TRACE_SIZE) == 0,
+         "schedstat with no events buffer");
+  if (before.run_cycles == 0)
+    fail ("no run time accounted");
+
+  child = exec ("child-simple");
+  CHECK (wait (child) == 81, "wait for child-simple");
+
+  events[SCHED_TRACE_SIZE].tsc = 0x5a5a5a5a;
+  n = schedstat (&after, events, SCHED_TRACE_SIZE + 1);
+  if (n <= 0 || n > SCHED_TRACE_SIZE)
+    fail ("schedstat returned %d events", n);
+  if (events[SCHED_TRACE_SIZE].tsc != 0x5a5a5a5a)
+    fail ("schedstat wrote past SCHED_TRACE_SIZE events");
+  msg ("trace clamped");
+
+  if (after.run_cycles < before.run_cycles)
+    fail ("run time went backwards");
+  if (after.voluntary <= before.voluntary)
+    fail ("waiting for the child was not a voluntary switch");
+  msg ("self stats updated");
+
+  exited = false;
+  for (i = 0; i < n; i++)
+    {
+      if (i > 0 && events[i].tsc < events[i - 1].tsc)
+        fail ("trace out of order at event %d", i);
+      if (events[i].from == child && events[i].reason == SCHED_EXIT)
+        exited = true;
+    }
+  if (!exited)
+    fail ("child's exit not in the trace");
+  msg ("child exit traced");
+
+  CHECK (schedstat (NULL, events, 1) == 1, "schedstat of one event");
+}
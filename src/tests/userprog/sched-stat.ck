@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-stat) begin
+(sched-stat) schedstat with no events buffer
+(child-simple) run
+child-simple: exit(81)
+(sched-stat) wait for child-simple
+(sched-stat) trace clamped
+(sched-stat) self stats updated
+(sched-stat) child exit traced
+(sched-stat) schedstat of one event
+(sched-stat) end
+sched-stat: exit(0)
+EOF
+pass;
@@ -0,0 +1,83 @@
+/* Writes a file in small pieces, reads it back and closes it,
+   all through the "submit" system call, one trap per batch. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK 16
+
+static struct ring ring;
+
+/* Queues an entry in RING. */
+static void
+queue (int op, int fd, void *buf, unsigned len)
+{
+  struct ring_sqe *sqe = &ring.sq[ring.sq_tail & RING_MASK];
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->user_data = ring.sq_tail;
+  ring.sq_tail++;
+}
+
+/* Reaps the next completion of RING and returns its result. */
+static int
+reap (void)
+{
+  struct ring_cqe *cqe = &ring.cq[ring.cq_head & RING_MASK];
+
+  if (ring.cq_head == ring.cq_tail)
+    fail ("completion queue is empty");
+  if (cqe->user_data != ring.cq_head)
+    fail ("completion %u out of order", cqe->user_data);
+  ring.cq_head++;
+  return cqe->res;
+}
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample - 1];
+  size_t ofs, size;
+  int handle, cnt, i;
+
+  CHECK (create ("ring.txt", sizeof sample - 1), "create \"ring.txt\"");
+
+  queue (RING_OPEN, 0, "ring.txt", 0);
+  CHECK (submit (&ring, 1) == 1, "submit open");
+  if ((handle = reap ()) < 2)
+    fail ("open returned %d", handle);
+
+  cnt = 0;
+  for (ofs = 0; ofs < sizeof buf; ofs += CHUNK, cnt++)
+    queue (RING_WRITE, handle, (char *) sample + ofs,
+           sizeof buf - ofs < CHUNK ? sizeof buf - ofs : CHUNK);
+  queue (RING_SEEK, handle, NULL, 0);
+  queue (RING_READ, handle, buf, sizeof buf);
+  queue (RING_CLOSE, handle, NULL, 0);
+  CHECK (submit (&ring, cnt + 3) == cnt + 3, "submit writes, read and close");
+
+  for (i = 0, ofs = 0; i < cnt; i++, ofs += size)
+    {
+      size = sizeof buf - ofs < CHUNK ? sizeof buf - ofs : CHUNK;
+      if (reap () != (int) size)
+        fail ("write %d was short", i);
+    }
+  if (reap () != 0)
+    fail ("seek failed");
+  if (reap () != (int) sizeof buf)
+    fail ("read was short");
+  if (reap () != 0)
+    fail ("close failed");
+  if (ring.sq_head != ring.sq_tail)
+    fail ("submissions left in the queue");
+
+  if (memcmp (buf, sample, sizeof buf))
+    fail ("read back different data");
+  msg ("read back the same data");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(submit-ring) begin
+(submit-ring) create "ring.txt"
+(submit-ring) submit open
+(submit-ring) submit writes, read and close
+(submit-ring) read back the same data
+(submit-ring) end
+submit-ring: exit(0)
+EOF
+pass;
@@ -0,0 +1,28 @@
+/* Grows the stack by a few pages and checks that the "vmstat"
+   system call counts the stack growth faults. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char stk_obj[4 * 4096];
+  struct vmstat before, after;
+  uint64_t grown;
+
+  CHECK (vmstat (&before), "vmstat");
+  memset (stk_obj, 0, sizeof stk_obj);
+  CHECK (vmstat (&after), "vmstat");
+
+  grown = (after.entries[VMSTAT_STACK].count
+           - before.entries[VMSTAT_STACK].count);
+  if (grown < 4)
+    fail ("%d stack growth faults counted, expected at least 4",
+          (int) grown);
+  if (after.entries[VMSTAT_STACK].cycles == 0)
+    fail ("stack growth took no time");
+  msg ("stack growth counted");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(vm-stat) begin
+(vm-stat) vmstat
+(vm-stat) vmstat
+(vm-stat) stack growth counted
+(vm-stat) end
+EOF
+pass;
@@ -0,0 +1,86 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Processor feature detection and control registers.
+   See [IA32-v2a] "CPUID" and [IA32-v3a] 2.5 "Control
+   Registers". */
+
+/* Feature flags returned by CPUID leaf 1 in EDX. */
+#define CPUID_PSE (1u << 3)             /* 4 MB pages. */
+
+/* Model-specific registers. */
+#define MSR_SYSENTER_CS 0x174           /* SYSENTER code selector. */
+#define MSR_SYSENTER_ESP 0x175          /* SYSENTER stack pointer. */
+#define MSR_SYSENTER_EIP 0x176          /* SYSENTER entry point. */
+
+/* CR4 bits. */
+#define CR4_PSE 0x00000010              /* Page size extensions. */
+
+/* Executes CPUID with EAX=LEAF and stores the four result
+   registers into *EAX, *EBX, *ECX, *EDX. */
+static inline void
+cpuid (uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+       uint32_t *ecx, uint32_t *edx)
+{
+  asm volatile ("cpuid"
+                : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+                : "a" (leaf));
+}
+
+/* Returns true if CPUID leaf 1 reports all of the FEATURES
+   bits (CPUID_*) in EDX. */
+static inline bool
+cpu_has_features (uint32_t features)
+{
+  uint32_t eax, ebx, ecx, edx;
+  cpuid (1, &eax, &ebx, &ecx, &edx);
+  return (edx & features) == features;
+}
+
+/* Returns the contents of CR4. */
+static inline uint32_t
+cr4_read (void)
+{
+  uint32_t cr4;
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  return cr4;
+}
+
+/* Stores CR4 into the CR4 register. */
+static inline void
+cr4_write (uint32_t cr4)
+{
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4) : "memory");
+}
+
+/* Returns the time stamp counter, which counts CPU cycles since
+   reset.  See [IA32-v2b] "RDTSC--Read Time-Stamp Counter". */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Stores VALUE into the model-specific register MSR.  See
+   [IA32-v2b] "WRMSR--Write to Model Specific Register". */
+static inline void
+wrmsr (uint32_t msr, uint64_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "A" (value));
+}
+
+/* Tells the CPU that this is a busy-wait loop, which saves
+   power and lets the other logical CPU of the core run.  See
+   [IA32-v2b] "PAUSE--Spin Loop Hint". */
+static inline void
+cpu_relax (void)
+{
+  asm volatile ("pause" : : : "memory");
+}
+
+#endif /* threads/cpu.h */
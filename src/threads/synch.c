@@ -29,9 +29,12 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+static heap_less_func waiter_less;
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -188,81 +191,129 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   Locks donate priority, so they keep their waiters in a heap by
+   priority instead of using a semaphore.  Each thread keeps the
+   locks it holds in a heap by the priority of their best waiter,
+   and its priority is the maximum of its own and the top of that
+   heap. */
 void
 lock_init (struct lock *lock)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
-  sema_init (&lock->semaphore, 1);
-	
+  lock->priority = PRI_MIN;
+  heap_init (&lock->waiters, waiter_less, NULL);
 }
 
-/* Acquires LOCK, sleeping until it becomes available if
-   necessary.  The lock must not already be held by the current
-   thread.
+/* Orders the waiters of a lock by priority, the one which waits
+   the longest first among equal priorities. */
+static bool
+waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+             void *aux UNUSED)
+{
+  const struct thread *a = heap_entry (a_, struct thread, waiter_elem);
+  const struct thread *b = heap_entry (b_, struct thread, waiter_elem);
 
-   This function may sleep, so it must not be called within an
-   interrupt handler.  This function may be called with
-   interrupts disabled, but interrupts will be turned back on if
-   we need to sleep. */
-void
-lock_acquire (struct lock *lock)
+  if (a->priority != b->priority)
+    return a->priority < b->priority;
+  return a->waiter_seq > b->waiter_seq;
+}
+
+/* Orders the locks held by a thread by the priority they donate. */
+bool
+lock_less (const struct heap_elem *a_, const struct heap_elem *b_,
+           void *aux UNUSED)
 {
-  ASSERT (lock != NULL);
-  ASSERT (!intr_context ());
-  ASSERT (!lock_held_by_current_thread (lock));
+  const struct lock *a = heap_entry (a_, struct lock, elem);
+  const struct lock *b = heap_entry (b_, struct lock, elem);
+
+  return a->priority < b->priority;
+}
 
-	//Vicente's implementation
-	enum intr_level old_level;
+/* Makes T the holder of LOCK, which donates the priority of its
+   best waiter to T.  Interrupts must be off. */
+static void
+lock_give (struct lock *lock, struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock->holder = t;
+  lock->priority = heap_empty (&lock->waiters) ? PRI_MIN
+    : heap_entry (heap_max (&lock->waiters), struct thread,
+                  waiter_elem)->priority;
+  heap_insert (&t->held_locks, &lock->elem);
+  if (!thread_mlfqs && lock->priority > t->priority)
+    thread_change_priority (t, lock->priority);
+}
 
-	//Disable interruptions
-	old_level = intr_disable();
+/* Propagates the priority of the current thread, which just
+   started waiting for LOCK, along the chain of lock holders.
+   Every step raises a priority, and stops as soon as nothing
+   changes, however long the chain is. */
+static void
+donate (struct lock *lock)
+{
+  int priority = thread_get_priority ();
 
-	//In case that the lock doesnt belong to nobody
-	if (lock->holder == NULL){
-		lock->origin_pri = thread_get_priority();
-		thread_current()->lock_to_be_open = true;
-		thread_current()->lock_owner = lock;
-	
-	//If not start but the priority is bigger than the holder start donate
-	} else if ( lock->holder->priority < thread_get_priority() )
-			donateRecursive( lock, thread_get_priority(), 0);
+  ASSERT (intr_get_level () == INTR_OFF);
 
-	//enable interruptions
-	intr_set_level(old_level);	
+  while (lock != NULL && lock->holder != NULL
+         && lock->priority < priority)
+    {
+      struct thread *holder = lock->holder;
 
-	thread_current()->lock_waiting = lock;
-  sema_down (&lock->semaphore);
-	thread_current()->lock_waiting = NULL;
+      /* Move LOCK up in the heap of its holder. */
+      heap_remove (&holder->held_locks, &lock->elem);
+      lock->priority = priority;
+      heap_insert (&holder->held_locks, &lock->elem);
 
-	//Assigning the lock to the current thread
-  lock->holder = thread_current ();
-	lock->holder->lock_to_be_open = true;
-	lock->origin_pri = thread_get_priority();
+      if (holder->priority >= priority)
+        break;
 
-	list_push_back(&lock->holder->poolThread, &lock->elem);
+      /* This also moves the holder up in the heap of the lock it
+         waits for, which is the next step. */
+      thread_change_priority (holder, priority);
+      lock = holder->lock_waiting;
+    }
 }
 
+/* Acquires LOCK, sleeping until it becomes available if
+   necessary.  The lock must not already be held by the current
+   thread.
 
-/*	This function will search until deph 8 wich priority should be 
-		donate to which thread */
-void 
-donateRecursive(struct lock *lock, int priority, int count)
+   This function may sleep, so it must not be called within an
+   interrupt handler.  This function may be called with
+   interrupts disabled, but interrupts will be turned back on if
+   we need to sleep. */
+void
+lock_acquire (struct lock *lock)
 {
-	if (lock->holder == NULL || lock->holder->priority >= priority || count == 8)
-		return;
-	
-	else { 
+  static unsigned waiter_seq;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
-			lock->holder->priority = thread_get_priority();
-			if ( lock->donated_pri < priority)
-				lock->donated_pri = thread_get_priority();
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (lock));
 
-			if (lock->holder->lock_waiting != NULL)
-				donateRecursive(lock->holder->lock_waiting, priority, count + 1);
-	}
+  old_level = intr_disable ();
+  if (lock->holder == NULL)
+    lock_give (lock, cur);
+  else
+    {
+      /* Wait until lock_release() hands the lock over to us. */
+      cur->lock_waiting = lock;
+      cur->waiter_seq = waiter_seq++;
+      heap_insert (&lock->waiters, &cur->waiter_elem);
+      if (!thread_mlfqs)
+        donate (lock);
+      thread_block ();
+      ASSERT (lock->holder == cur);
+    }
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -274,61 +325,56 @@ donateRecursive(struct lock *lock, int priority, int count)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
-  success = sema_try_down (&lock->semaphore);
+  old_level = intr_disable ();
+  success = lock->holder == NULL;
   if (success)
-    lock->holder = thread_current ();
+    lock_give (lock, thread_current ());
+  intr_set_level (old_level);
   return success;
 }
 
-/* 	This function return the result of the comparison between the
-		priority of the threads which hold the given locks*/
-bool
-lock_sort (const struct list_elem *b_e, const struct list_elem *s_e, void *aux UNUSED)
-{
-  struct lock *bigger_l, *smaller_l;
-  bigger_l = list_entry(b_e, struct lock, elem);
-  smaller_l = list_entry(s_e, struct lock, elem);
-  return (bigger_l->donated_pri) > (smaller_l->donated_pri);
-}
-
 /* Releases LOCK, which must be owned by the current thread.
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
-   handler. */
+   handler.
 
+   The lock goes straight to its highest priority waiter, and
+   the current thread drops the priority LOCK donated to it. */
 void
 lock_release (struct lock *lock) 
 {
+  struct thread *cur = thread_current ();
+  struct thread *next = NULL;
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
-	enum intr_level old_level;
-	old_level = intr_disable();
-	
-	list_remove(&lock->elem);
-
-	if (lock->origin_pri != thread_get_priority() && thread_current() == lock->holder) {
+  old_level = intr_disable ();
+  heap_remove (&cur->held_locks, &lock->elem);
+  lock->holder = NULL;
 
-			if (list_empty (&lock->holder->poolThread))
-				thread_current()->priority = thread_current()->priority_original;
+  if (!heap_empty (&lock->waiters))
+    {
+      next = heap_entry (heap_pop_max (&lock->waiters), struct thread,
+                         waiter_elem);
+      next->lock_waiting = NULL;
+      lock_give (lock, next);
+      thread_unblock (next);
+    }
 
-			else {
-				list_sort(&(lock->holder->poolThread), lock_sort, NULL);
-				thread_current()->priority = list_entry( 
-					list_front(&lock->holder->poolThread), struct lock, elem)->donated_pri;
-			}	
-	}
-	intr_set_level(old_level);
+  if (!thread_mlfqs)
+    thread_refresh_priority (cur);
+  intr_set_level (old_level);
 
-  lock->holder = NULL;
-	thread_current ()->lock_owner= NULL;
-  sema_up (&lock->semaphore);
-	thread_current()->lock_to_be_open = false;
+  if (next != NULL && next->priority > thread_get_priority ())
+    thread_yield ();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -342,6 +388,270 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Initializes RWLOCK.  A readers-writer lock lets any number
+   of readers in at the same time, or a single writer.
+
+   It prefers writers: a writer takes RWLOCK->writer first and
+   holds it while it waits for the readers inside to leave, and a
+   reader must get past the same lock to enter.  So readers that
+   arrive after a writer wait for it, instead of starving it.
+
+   Since readers and writers wait for a plain lock, they donate
+   their priority to the writer inside or about to enter, and the
+   writer hands the lock over to the highest priority waiter when
+   it is done.  The first RWLOCK_READERS readers inside each hold
+   one of the locks in RWLOCK->inside, so a writer waiting for
+   them to leave donates its priority to them through donate(),
+   along with the threads they wait for in turn.  Readers beyond
+   those are only counted. */
+void
+rwlock_init (struct rwlock *rwlock)
+{
+  int i;
+
+  ASSERT (rwlock != NULL);
+
+  lock_init (&rwlock->writer);
+  rwlock->readers = 0;
+  for (i = 0; i < RWLOCK_READERS; i++)
+    lock_init (&rwlock->inside[i]);
+  sema_init (&rwlock->drained, 0);
+  rwlock->draining = false;
+}
+
+/* Acquires RWLOCK for reading, sleeping while a writer holds it
+   or waits for it.  The current thread must not hold RWLOCK for
+   writing.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rwlock)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rwlock));
+
+  lock_acquire (&rwlock->writer);
+  old_level = intr_disable ();
+  rwlock->readers++;
+  for (i = 0; i < RWLOCK_READERS; i++)
+    if (rwlock->inside[i].holder == NULL)
+      {
+        lock_give (&rwlock->inside[i], cur);
+        break;
+      }
+  intr_set_level (old_level);
+  lock_release (&rwlock->writer);
+}
+
+/* Releases RWLOCK, which the current thread holds for reading,
+   along with the priority a waiting writer donated to it.  The
+   last reader to leave lets a waiting writer in. */
+void
+rwlock_release_read (struct rwlock *rwlock)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (rwlock->readers > 0);
+
+  old_level = intr_disable ();
+  for (i = 0; i < RWLOCK_READERS; i++)
+    if (rwlock->inside[i].holder == cur)
+      {
+        heap_remove (&cur->held_locks, &rwlock->inside[i].elem);
+        rwlock->inside[i].holder = NULL;
+        rwlock->inside[i].priority = PRI_MIN;
+        if (!thread_mlfqs)
+          thread_refresh_priority (cur);
+        break;
+      }
+  if (--rwlock->readers == 0 && rwlock->draining)
+    {
+      rwlock->draining = false;
+      sema_up (&rwlock->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RWLOCK for writing, sleeping until the other writers
+   and all the readers are gone, and donating its priority to the
+   readers it waits for.  The current thread must not hold
+   RWLOCK, neither for reading nor for writing.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwlock->writer);
+  old_level = intr_disable ();
+  if (rwlock->readers > 0)
+    {
+      if (!thread_mlfqs)
+        for (i = 0; i < RWLOCK_READERS; i++)
+          donate (&rwlock->inside[i]);
+      rwlock->draining = true;
+      sema_down (&rwlock->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Releases RWLOCK, which the current thread holds for writing. */
+void
+rwlock_release_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_release (&rwlock->writer);
+}
+
+/* Returns true if the current thread holds RWLOCK for writing,
+   false otherwise. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  return lock_held_by_current_thread (&rwlock->writer);
+}
+
+/* Maximum number of times adaptive_lock_acquire() polls a lock
+   held by a running thread before going to sleep. */
+#define ADAPTIVE_SPIN_MAX 1000
+
+/* All adaptive locks, for adaptive_lock_print_stats().  Adaptive
+   locks are never destroyed. */
+static struct list adaptive_locks = LIST_INITIALIZER (adaptive_locks);
+
+/* Initializes adaptive lock LOCK, which is called NAME in the
+   statistics. */
+void
+adaptive_lock_init (struct adaptive_lock *lock, const char *name)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (name != NULL);
+
+  lock_init (&lock->lock);
+  lock->name = name;
+  lock->stamp = 0;
+  lock->acquires = lock->contended = lock->spins = lock->blocked = 0;
+  lock->hold_cycles = lock->max_hold = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&adaptive_locks, &lock->elem);
+  intr_set_level (old_level);
+}
+
+/* Acquires LOCK.  If it is held, polls it as long as its holder
+   is running, up to ADAPTIVE_SPIN_MAX times, then sleeps like
+   lock_acquire().  With a single CPU the holder is never running,
+   so a contended acquire goes to sleep at once.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+adaptive_lock_acquire (struct adaptive_lock *lock)
+{
+  bool contended = false;
+  bool blocked = false;
+  unsigned spins = 0;
+
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+
+  if (!lock_try_acquire (&lock->lock))
+    {
+      contended = true;
+      for (;;)
+        {
+          struct thread *holder = lock->lock.holder;
+
+          if (holder != NULL
+              && (holder->status != THREAD_RUNNING
+                  || spins >= ADAPTIVE_SPIN_MAX))
+            {
+              lock_acquire (&lock->lock);
+              blocked = true;
+              break;
+            }
+          if (lock_try_acquire (&lock->lock))
+            break;
+          cpu_relax ();
+          spins++;
+        }
+    }
+
+  /* The counters are protected by LOCK itself. */
+  lock->acquires++;
+  lock->contended += contended;
+  lock->spins += spins;
+  lock->blocked += blocked;
+  lock->stamp = rdtsc ();
+}
+
+/* Releases LOCK, which must be owned by the current thread. */
+void
+adaptive_lock_release (struct adaptive_lock *lock)
+{
+  uint64_t held;
+
+  ASSERT (lock != NULL);
+  ASSERT (adaptive_lock_held_by_current_thread (lock));
+
+  held = rdtsc () - lock->stamp;
+  lock->hold_cycles += held;
+  if (held > lock->max_hold)
+    lock->max_hold = held;
+  lock_release (&lock->lock);
+}
+
+/* Returns true if the current thread holds LOCK, false
+   otherwise. */
+bool
+adaptive_lock_held_by_current_thread (const struct adaptive_lock *lock)
+{
+  ASSERT (lock != NULL);
+
+  return lock_held_by_current_thread (&lock->lock);
+}
+
+/* Prints the statistics of every adaptive lock that was used. */
+void
+adaptive_lock_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&adaptive_locks); e != list_end (&adaptive_locks);
+       e = list_next (e))
+    {
+      struct adaptive_lock *lock = list_entry (e, struct adaptive_lock, elem);
+
+      if (lock->acquires == 0)
+        continue;
+      printf ("Lock %s: %u acquires, %u contended (%u spins, %u blocked), "
+              "%llu cycles held avg, %llu max\n",
+              lock->name, lock->acquires, lock->contended, lock->spins,
+              lock->blocked, lock->hold_cycles / lock->acquires,
+              lock->max_hold);
+    }
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
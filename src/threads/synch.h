@@ -2,7 +2,9 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <heap.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -21,24 +23,62 @@ void sema_self_test (void);
 struct lock 
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
-    struct semaphore semaphore; /* Binary semaphore controlling access. */
-		struct list *poolThread;
-		struct list_elem elem; 
-
-		// origin_priority and is_donated
-		int origin_pri;							/* original priority use for donate*/
-		int donated_pri;						/* priority which is already donated*/
-
+    struct heap waiters;        /* Waiting threads, by priority. */
+    int priority;               /* Priority of the best waiter. */
+    struct heap_elem elem;      /* Element in the holder's held_locks. */
   };
 
 void lock_init (struct lock *);
 void lock_acquire (struct lock *);
-void donateRecursive(struct lock *, int, int);
 bool lock_try_acquire (struct lock *);
-bool lock_sort (const struct list_elem*, const struct list_elem *, void *);
+bool lock_less (const struct heap_elem *, const struct heap_elem *, void *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Readers-writer lock. */
+#define RWLOCK_READERS 4        /* # of readers tracked for donation. */
+struct rwlock
+  {
+    struct lock writer;         /* Held by the writer, also while it
+                                   waits for the readers to leave. */
+    unsigned readers;           /* Number of readers inside. */
+    struct lock inside[RWLOCK_READERS]; /* Held by readers inside. */
+    struct semaphore drained;   /* Wakes up the writer at last reader. */
+    bool draining;              /* A writer waits on `drained'. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+
+/* Adaptive lock, for critical sections of a few instructions.
+   It spins for a while when the holder is running on another
+   CPU, which will release it soon, and blocks like a lock
+   otherwise.  It also counts contention and hold times, which
+   are printed at shutdown. */
+struct adaptive_lock
+  {
+    struct lock lock;           /* The lock itself. */
+    const char *name;           /* Name in the statistics. */
+    uint64_t stamp;             /* When the holder acquired it. */
+    unsigned acquires;          /* # of times acquired. */
+    unsigned contended;         /* # of times it was held already. */
+    unsigned spins;             /* # of spin iterations. */
+    unsigned blocked;           /* # of times a thread had to sleep. */
+    uint64_t hold_cycles;       /* Total time held, in TSC cycles. */
+    uint64_t max_hold;          /* Longest time held. */
+    struct list_elem elem;      /* Element in the list of all of them. */
+  };
+
+void adaptive_lock_init (struct adaptive_lock *, const char *name);
+void adaptive_lock_acquire (struct adaptive_lock *);
+void adaptive_lock_release (struct adaptive_lock *);
+bool adaptive_lock_held_by_current_thread (const struct adaptive_lock *);
+void adaptive_lock_print_stats (void);
+
 /* Condition variable. */
 struct condition 
   {
@@ -11,6 +11,8 @@
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/cpu.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -20,15 +22,25 @@
 	 of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-	 that are ready to run but not actually running. */
-
-static struct list ready_list;
+/* Lists of processes in THREAD_READY state, that is, processes
+	 that are ready to run but not actually running.  There is one
+	 FIFO list per priority, and bit N of ready_bitmap is set when
+	 the list of priority N is not empty, so that picking the next
+	 thread is a find-first-set.  The 64-bit bitmap is kept as two
+	 32-bit words because the kernel does not link libgcc. */
+static struct list ready_list[PRI_MAX + 1];
+static uint32_t ready_bitmap[2];
 
 /* List of all processes.  Processes are added to this list
 	 when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
+/* The same processes hashed by tid, for tid_to_thread().  Tids
+	 are handed out in sequence, so the remainder spreads them
+	 evenly over the buckets. */
+#define TID_HASH_SIZE 64
+static struct list tid_hash[TID_HASH_SIZE];
+
 /* Idle thread. */
 static struct thread *idle_thread;
 
@@ -36,7 +48,7 @@ static struct thread *idle_thread;
 static struct thread *initial_thread;
 
 /* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+static struct adaptive_lock tid_lock;
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
@@ -55,11 +67,34 @@ static long long user_ticks;    /* # of timer ticks in user programs. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* Ring buffer of the last SCHED_TRACE_SIZE context switches. */
+static struct sched_event sched_trace[SCHED_TRACE_SIZE];
+static unsigned sched_trace_cnt;        /* # of switches ever traced. */
+static long long voluntary_switches;    /* Blocked, yielded or exited. */
+static long long involuntary_switches;  /* Preempted. */
+
+/* Number of trace events printed at shutdown. */
+#define SCHED_TRACE_PRINT 16
+static const char *sched_reasons[] = {"block", "yield", "preempt", "exit"};
+
 /* If false (default), use round-robin scheduler.
 	 If true, use multi-level feedback queue scheduler.
 	 Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler state. */
+static fixed_t load_avg;        /* System load average. */
+static int ready_cnt;           /* # of threads in the ready lists. */
+
+/* Threads whose recent_cpu or nice is not zero.  The others keep
+	 recent_cpu 0 and priority PRI_MAX forever, so the update once a
+	 second skips them. */
+static struct list mlfqs_list;
+
+/* Threads that ran since the last priority update, which happens
+	 every fourth tick.  Only their recent_cpu has changed. */
+static struct list dirty_list;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -68,16 +103,26 @@ static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
-static void schedule (void);
+static void schedule (enum sched_reason);
+static void yield (enum sched_reason);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct list *tid_bucket (tid_t);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_highest (void);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_track (struct thread *);
+static int mlfqs_priority (struct thread *);
+static void mlfqs_update_second (void);
+static void mlfqs_update_dirty (void);
 
 /* Initializes the threading system by transforming the code
 	 that's currently running into a thread.  This can't work in
 	 general and it is possible in this case only because loader.S
 	 was careful to put the bottom of the stack at a page boundary.
 
-	 Also initializes the run queue and the tid lock.
+	 Also initializes the run queue, the tid hash and the tid lock.
 
 	 After calling this function, be sure to initialize the page
 	 allocator before trying to create any threads with
@@ -90,15 +135,25 @@ thread_init (void)
 {
 	ASSERT (intr_get_level () == INTR_OFF);
 
-	lock_init (&tid_lock);
-	list_init (&ready_list);
+	int pri, i;
+
+	adaptive_lock_init (&tid_lock, "tid");
+	for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init (&ready_list[pri]);
 	list_init (&all_list);
+	for (i = 0; i < TID_HASH_SIZE; i++)
+		list_init (&tid_hash[i]);
+	list_init (&mlfqs_list);
+	list_init (&dirty_list);
+	load_avg = 0;
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
+	list_push_back (tid_bucket (initial_thread->tid), &initial_thread->tid_elem);
+	initial_thread->sched_stamp = rdtsc ();
 
 }
 
@@ -120,7 +175,9 @@ thread_start (void)
 }
 
 /* Called by the timer interrupt handler at each timer tick.
-	 Thus, this function runs in an external interrupt context. */
+	 Thus, this function runs in an external interrupt context,
+	 except for the ticks the timer skipped while the idle thread
+	 was running, which it catches up on in the idle thread. */
 	void
 thread_tick (void) 
 {
@@ -136,17 +193,147 @@ thread_tick (void)
 	else
 		kernel_ticks++;
 
+	if (thread_mlfqs)
+		mlfqs_tick (t);
+
 	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	if (++thread_ticks >= TIME_SLICE && intr_context ())
+		intr_yield_on_return ();
+}
+
+/* Multi-level feedback queue bookkeeping for a timer tick while
+	 T is running.  See [4.4BSD] for the formulas.  Runs in an
+	 external interrupt context. */
+static void
+mlfqs_tick (struct thread *t)
+{
+	int64_t now = timer_ticks ();
+
+	if (t != idle_thread)
+	{
+		t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+		mlfqs_track (t);
+		if (!t->mlfqs_dirty)
+		{
+			list_push_back (&dirty_list, &t->dirty_elem);
+			t->mlfqs_dirty = true;
+		}
+	}
+
+	if (now % TIMER_FREQ == 0)
+		mlfqs_update_second ();
+	if (now % TIME_SLICE == 0)
+		mlfqs_update_dirty ();
+
+	if (ready_highest () > t->priority && intr_context ())
 		intr_yield_on_return ();
 }
 
+/* Adds T to mlfqs_list if it is not there yet. */
+static void
+mlfqs_track (struct thread *t)
+{
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!t->mlfqs_listed)
+	{
+		list_push_back (&mlfqs_list, &t->mlfqs_elem);
+		t->mlfqs_listed = true;
+	}
+}
+
+/* Returns the priority of T computed from its recent_cpu and
+	 nice values. */
+static int
+mlfqs_priority (struct thread *t)
+{
+	int priority = PRI_MAX - fp_trunc (t->recent_cpu / 4) - t->nice * 2;
+
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	else if (priority > PRI_MAX)
+		priority = PRI_MAX;
+	return priority;
+}
+
+/* Updates the load average, and the recent_cpu and priority of
+	 every thread in mlfqs_list.  Threads whose recent_cpu has
+	 decayed to 0 and whose nice is 0 leave the list. */
+static void
+mlfqs_update_second (void)
+{
+	struct thread *cur = thread_current ();
+	int ready = ready_cnt + (cur != idle_thread ? 1 : 0);
+	struct list_elem *e;
+	fixed_t coef;
+
+	load_avg = fp_mul (fp_div (fp_int (59), fp_int (60)), load_avg)
+		+ fp_int (ready) / 60;
+	coef = fp_div (2 * load_avg, fp_add_int (2 * load_avg, 1));
+
+	for (e = list_begin (&mlfqs_list); e != list_end (&mlfqs_list);)
+	{
+		struct thread *t = list_entry (e, struct thread, mlfqs_elem);
+
+		t->recent_cpu = fp_add_int (fp_mul (coef, t->recent_cpu), t->nice);
+		thread_change_priority (t, mlfqs_priority (t));
+		if (t->recent_cpu == 0 && t->nice == 0)
+		{
+			e = list_remove (e);
+			t->mlfqs_listed = false;
+		}
+		else
+			e = list_next (e);
+	}
+}
+
+/* Recomputes the priority of the threads in dirty_list, and
+	 empties it. */
+static void
+mlfqs_update_dirty (void)
+{
+	while (!list_empty (&dirty_list))
+	{
+		struct thread *t = list_entry (list_pop_front (&dirty_list),
+				struct thread, dirty_elem);
+		t->mlfqs_dirty = false;
+		thread_change_priority (t, mlfqs_priority (t));
+	}
+}
+
 /* Prints thread statistics. */
 	void
 thread_print_stats (void) 
 {
+	struct list_elem *e;
+	enum intr_level old_level;
+	unsigned i;
+
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+	printf ("Thread: %lld voluntary switches, %lld involuntary switches\n",
+			voluntary_switches, involuntary_switches);
+
+	old_level = intr_disable ();
+	for (e = list_begin (&all_list); e != list_end (&all_list);
+			e = list_next (e))
+	{
+		struct thread *t = list_entry (e, struct thread, allelem);
+		printf ("Thread: %s (tid %d): %llu cycles running, %llu cycles ready, "
+				"%u voluntary, %u involuntary\n", t->name, t->tid,
+				t->sched.run_cycles, t->sched.wait_cycles,
+				t->sched.voluntary, t->sched.involuntary);
+	}
+
+	i = sched_trace_cnt > SCHED_TRACE_PRINT
+		? sched_trace_cnt - SCHED_TRACE_PRINT : 0;
+	for (; i < sched_trace_cnt; i++)
+	{
+		struct sched_event *ev = &sched_trace[i % SCHED_TRACE_SIZE];
+		printf ("Thread: switch %d -> %d (%s) at %llu\n",
+				ev->from, ev->to, sched_reasons[ev->reason], ev->tsc);
+	}
+	intr_set_level (old_level);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -182,16 +369,23 @@ thread_create (const char *name, int priority,
 	if (t == NULL)
 		return TID_ERROR;
 	curr = thread_current();
-	/* Initialize thread. */
+	/* Initialize thread.  Under the multi-level feedback queue
+		 scheduler the priority comes from the niceness and
+		 recent_cpu, which are inherited from the parent. */
 	init_thread (t, name, priority);
-	//curr->lock_child = &t->wait;
-	t->parent = thread_current();
+	if (thread_mlfqs)
+	{
+		t->nice = curr->nice;
+		t->recent_cpu = curr->recent_cpu;
+		priority = t->priority = t->priority_original = mlfqs_priority (t);
+	}
 	tid = t->tid = allocate_tid ();
 
 	/* Prepare thread for first run by initializing its stack.
 		 Do this atomically so intermediate values for the 'stack' 
 		 member cannot be observed. */
 	old_level = intr_disable ();
+	list_push_back (tid_bucket (tid), &t->tid_elem);
 
 	/* Stack frame for kernel_thread(). */
 	kf = alloc_frame (t, sizeof *kf);
@@ -208,14 +402,13 @@ thread_create (const char *name, int priority,
 	sf->eip = switch_entry;
 	sf->ebp = 0;
 
+	if (t->nice != 0 || t->recent_cpu != 0)
+		mlfqs_track (t);
+
 	intr_set_level (old_level);
 
 	/* Add to run queue. */
 	thread_unblock (t);
-#ifdef USERPROG
-	initial_thread->parent = thread_current ();
-	sema_init(&t->my_sema, 0);
-#endif
 
 	if(priority > thread_current ()->priority)
 		thread_yield ();
@@ -236,7 +429,7 @@ thread_block (void)
 	ASSERT (intr_get_level () == INTR_OFF);
 
 	thread_current ()->status = THREAD_BLOCKED;
-	schedule ();
+	schedule (SCHED_BLOCK);
 }
 
 /* Transitions a blocked thread T to the ready-to-run state.
@@ -256,13 +449,9 @@ thread_unblock (struct thread *t)
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	//Vicente's implementation
-
-	//Insert the unblock thread in the ready list in order
-	list_insert_ordered(&ready_list, &t->elem, comp_priority, NULL);
-	//END Vicente's implementation
-
+	ready_push (t);
 	t->status = THREAD_READY;
+	t->sched_stamp = rdtsc ();
 	intr_set_level (old_level);
 }
 
@@ -307,21 +496,6 @@ thread_exit (void)
 	ASSERT (!intr_context ());
 
 #ifdef USERPROG
-	struct list_elem *elem;
-	struct thread *t, *current = thread_current ();
-	
-	for (elem = list_begin (&current->children); elem != list_end (&current->children); elem = list_next (elem))
-	{
-		t = list_entry (elem, struct thread, child_elem);
-		if (t->status == THREAD_BLOCKED && t->is_exit)
-			thread_unblock (t);
-		else
-		{
-			t->parent = NULL;
-			list_remove (&t->child_elem);
-		}
-	}
-
 	process_exit ();
 #endif
 
@@ -330,8 +504,13 @@ thread_exit (void)
 		 when it calls thread_schedule_tail(). */
 	intr_disable ();
 	list_remove (&thread_current()->allelem);
+	list_remove (&thread_current()->tid_elem);
+	if (thread_current ()->mlfqs_listed)
+		list_remove (&thread_current ()->mlfqs_elem);
+	if (thread_current ()->mlfqs_dirty)
+		list_remove (&thread_current ()->dirty_elem);
 	thread_current ()->status = THREAD_DYING;
-	schedule ();
+	schedule (SCHED_EXIT);
 	NOT_REACHED ();
 }
 
@@ -339,6 +518,23 @@ thread_exit (void)
 	 may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void) 
+{
+	yield (SCHED_YIELD);
+}
+
+/* Yields the CPU because an interrupt handler asked for it with
+	 intr_yield_on_return(), e.g. when the time slice is over.
+	 Counted as an involuntary switch. */
+void
+thread_preempt (void) 
+{
+	yield (SCHED_PREEMPT);
+}
+
+/* Puts the current thread back in the ready lists and schedules,
+	 recording REASON. */
+static void
+yield (enum sched_reason reason) 
 {
 	struct thread *cur = thread_current ();
 	enum intr_level old_level;
@@ -347,14 +543,11 @@ thread_yield (void)
 
 	old_level = intr_disable ();
 
-	//Vicente's implementation
 	if (cur != idle_thread) 
-		//Insert in order the thread to the ready list
-		list_insert_ordered(&ready_list, &cur->elem, comp_priority, NULL);
-	//End Vicente's implementation
+		ready_push (cur);
 
 	cur->status = THREAD_READY;
-	schedule ();
+	schedule (reason);
 	intr_set_level (old_level);
 }
 
@@ -379,21 +572,65 @@ thread_foreach (thread_action_func *func, void *aux)
 void
 thread_set_priority (int new_priority) 
 {
+	//The multi-level feedback queue scheduler sets priorities itself
+	if (thread_mlfqs)
+		return;
 
-	//Vicente's implementation
-
-	//Set the original priority to the given priority
+	//Donated priorities still apply on top of the new one
 	thread_current ()->priority_original = new_priority;
+	thread_refresh_priority (thread_current ());
 
-	//In case that the new priority is bigger or there are not any thread waiting
-	//the current thread for up any semaphore (release lock) change the priority
-	if (thread_get_priority() < new_priority || list_empty(&thread_current()->poolThread)) 
-		thread_current ()->priority = new_priority;
+	//Let a higher priority thread run
+	if (!is_thread_highest ())
+		thread_yield();
+}
 
-	//Sort ready list and schedule the threads
-	list_sort(&ready_list, comp_priority, NULL);
-	thread_yield();
-	//END vicente's implementation
+/* Sets the priority of thread T to PRIORITY, moving T to the
+	 right ready list if it is ready to run.  Used for priority
+	 donation, which changes the priority of other threads. */
+void
+thread_change_priority (struct thread *t, int priority)
+{
+	enum intr_level old_level;
+
+	ASSERT (is_thread (t));
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	old_level = intr_disable ();
+	if (t->status == THREAD_READY && t->priority != priority)
+	{
+		ready_remove (t);
+		t->priority = priority;
+		ready_push (t);
+	}
+	else if (t->lock_waiting != NULL && t->priority != priority)
+	{
+		//Keep the waiters heap of the lock in order
+		heap_remove (&t->lock_waiting->waiters, &t->waiter_elem);
+		t->priority = priority;
+		heap_insert (&t->lock_waiting->waiters, &t->waiter_elem);
+	}
+	else
+		t->priority = priority;
+	intr_set_level (old_level);
+}
+
+/* Recomputes the priority of T from its own priority and the
+	 priorities donated by the waiters of the locks it holds. */
+void
+thread_refresh_priority (struct thread *t)
+{
+	int priority = t->priority_original;
+	enum intr_level old_level = intr_disable ();
+
+	if (!heap_empty (&t->held_locks))
+	{
+		struct lock *l = heap_entry (heap_max (&t->held_locks), struct lock, elem);
+		if (l->priority > priority)
+			priority = l->priority;
+	}
+	thread_change_priority (t, priority);
+	intr_set_level (old_level);
 }
 
 /* Returns the current thread's priority. */
@@ -403,35 +640,93 @@ thread_get_priority (void)
 	return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, recomputes its
+	 priority and yields if it no longer has the highest
+	 priority. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-	/* Not yet implemented. */
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	else if (nice > NICE_MAX)
+		nice = NICE_MAX;
+
+	old_level = intr_disable ();
+	cur->nice = nice;
+	mlfqs_track (cur);
+	if (thread_mlfqs)
+		cur->priority = mlfqs_priority (cur);
+	intr_set_level (old_level);
+
+	if (!is_thread_highest ())
+		thread_yield ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-	/* Not yet implemented. */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-	/* Not yet implemented. */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int load = fp_round (load_avg * 100);
+	intr_set_level (old_level);
+	return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-	/* Not yet implemented. */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int recent = fp_round (thread_current ()->recent_cpu * 100);
+	intr_set_level (old_level);
+	return recent;
+}
+
+/* Stores the scheduler accounting of the current thread into
+	 *STAT, including the time slice it is running now. */
+void
+thread_get_sched_stat (struct sched_thread_stat *stat)
+{
+	struct thread *cur = thread_current ();
+	enum intr_level old_level = intr_disable ();
+
+	*stat = cur->sched;
+	stat->run_cycles += rdtsc () - cur->sched_stamp;
+	intr_set_level (old_level);
+}
+
+/* Copies the last MAX context switches of the trace into EVENTS,
+	 oldest first, and returns how many it copied.  EVENTS must be
+	 in kernel memory. */
+int
+thread_get_sched_trace (struct sched_event *events, int max)
+{
+	enum intr_level old_level;
+	unsigned first;
+	int n;
+
+	if (max > SCHED_TRACE_SIZE)
+		max = SCHED_TRACE_SIZE;
+	if (max <= 0)
+		return 0;
+
+	old_level = intr_disable ();
+	first = sched_trace_cnt > (unsigned) max ? sched_trace_cnt - max : 0;
+	for (n = 0; first + n < sched_trace_cnt; n++)
+		events[n] = sched_trace[(first + n) % SCHED_TRACE_SIZE];
+	intr_set_level (old_level);
+
+	return n;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -455,6 +750,7 @@ idle (void *idle_started_ UNUSED)
 		/* Let someone else run. */
 		intr_disable ();
 		thread_block ();
+		timer_idle_enter ();
 
 		/* Re-enable interrupts and wait for the next one.
 
@@ -469,6 +765,9 @@ idle (void *idle_started_ UNUSED)
 			 See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
 			 7.11.1 "HLT Instruction". */
 		asm volatile ("sti; hlt" : : : "memory");
+
+		/* Catch up on the ticks skipped while halted. */
+		timer_idle_exit ();
 	}
 }
 
@@ -521,18 +820,15 @@ init_thread (struct thread *t, const char *name, int priority)
 
 	//Vicente's implementation
 	t->priority_original = priority;				/*initializing some parameters*/
-	list_init(&t->poolThread);
-	t->lock_owner = NULL;
-	t->lock_to_be_open = false;
+	heap_init (&t->held_locks, lock_less, NULL);
+	t->lock_waiting = NULL;
 	//END Vicente's implementation
 
 	t->magic = THREAD_MAGIC;
 #ifdef USERPROG
 	//Choi's implementation
 	list_init (&t->children);
-	t->is_exit = false;
-	t->child_status = 0;
-	list_init (&t->files);
+	t->exit_status = -1;
 #endif
 
 #ifdef VM
@@ -563,13 +859,50 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-	if (list_empty (&ready_list))
+	struct thread *t;
+	int pri = ready_highest ();
+
+	if (pri < 0)
 		return idle_thread;
-	else
-	{
-		list_sort (&ready_list, comp_priority, NULL);
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
-	}
+
+	t = list_entry (list_front (&ready_list[pri]), struct thread, elem);
+	ready_remove (t);
+	return t;
+}
+
+/* Appends T to the ready list of its priority. */
+static void
+ready_push (struct thread *t)
+{
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	list_push_back (&ready_list[t->priority], &t->elem);
+	ready_cnt++;
+	ready_bitmap[t->priority / 32] |= 1u << (t->priority % 32);
+}
+
+/* Removes T from the ready list of its priority. */
+static void
+ready_remove (struct thread *t)
+{
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	list_remove (&t->elem);
+	ready_cnt--;
+	if (list_empty (&ready_list[t->priority]))
+		ready_bitmap[t->priority / 32] &= ~(1u << (t->priority % 32));
+}
+
+/* Returns the highest priority of a ready thread, or -1 if no
+	 thread is ready. */
+static int
+ready_highest (void)
+{
+	if (ready_bitmap[1] != 0)
+		return 63 - __builtin_clz (ready_bitmap[1]);
+	if (ready_bitmap[0] != 0)
+		return 31 - __builtin_clz (ready_bitmap[0]);
+	return -1;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -626,7 +959,7 @@ thread_schedule_tail (struct thread *prev)
 	 It's not safe to call printf() until thread_schedule_tail()
 	 has completed. */
 static void
-schedule (void) 
+schedule (enum sched_reason reason) 
 {
 	struct thread *cur = running_thread ();
 	struct thread *next = next_thread_to_run ();
@@ -637,7 +970,35 @@ schedule (void)
 	ASSERT (is_thread (next));
 
 	if (cur != next)
+	{
+		uint64_t now = rdtsc ();
+		struct sched_event *ev = &sched_trace[sched_trace_cnt++ % SCHED_TRACE_SIZE];
+
+		/* Account the time slice CUR ran, and the time NEXT spent in
+			 the ready lists.  The idle thread is never in them. */
+		cur->sched.run_cycles += now - cur->sched_stamp;
+		cur->sched_stamp = now;
+		if (reason == SCHED_PREEMPT)
+		{
+			cur->sched.involuntary++;
+			involuntary_switches++;
+		}
+		else
+		{
+			cur->sched.voluntary++;
+			voluntary_switches++;
+		}
+		if (next->status == THREAD_READY)
+			next->sched.wait_cycles += now - next->sched_stamp;
+		next->sched_stamp = now;
+
+		ev->from = cur->tid;
+		ev->to = next->tid;
+		ev->reason = reason;
+		ev->tsc = now;
+
 		prev = switch_threads (cur, next);
+	}
 	thread_schedule_tail (prev);
 }
 
@@ -660,9 +1021,9 @@ allocate_tid (void)
 	static tid_t next_tid = 1;
 	tid_t tid;
 
-	lock_acquire (&tid_lock);
+	adaptive_lock_acquire (&tid_lock);
 	tid = next_tid++;
-	lock_release (&tid_lock);
+	adaptive_lock_release (&tid_lock);
 
 	return tid;
 }
@@ -674,44 +1035,47 @@ uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
 //Vicente's implementation
 
-/*Sort the ready list */
-void 
-sort_readyList(void)
-{
-	list_sort(&ready_list, comp_priority, NULL);
-}
-
-
 /* 	This function return if the current thread is the thread
 		with the higest priority */
 bool 
 is_thread_highest(void)
 {
-	//Pick the thread with the highest priority in the ready list
-	sort_readyList();
-	int highest_pri = (list_entry (list_front (&ready_list), struct thread, elem))->priority;
-
-	//Compare with the current thread
-	if (thread_get_priority() < highest_pri)
-		return false;
-	else
-		return true;
+	//Compare with the highest priority in the ready lists
+	return thread_get_priority() >= ready_highest ();
 }
 //END Vicente's implementation
 
 
+/* Returns the thread whose tid is TID, or a null pointer if there
+	 is none or it is exiting.  The thread may exit as soon as
+	 interrupts are on again, unless the caller knows otherwise. */
 struct thread
 *tid_to_thread (tid_t tid)
 {	
+	struct list *bucket = tid_bucket (tid);
+	struct thread *found = NULL;
 	struct list_elem *elem;
-	struct thread *t;
+	enum intr_level old_level;
 
-	elem = list_head (&all_list);
-	while ((elem = list_next (elem)) != list_tail (&all_list))
+	old_level = intr_disable ();
+	for (elem = list_begin (bucket); elem != list_end (bucket);
+			elem = list_next (elem))
 	{
-		t = list_entry (elem, struct thread, allelem);
-		if (t->status != THREAD_DYING && t->tid == tid)
-			return t;
+		struct thread *t = list_entry (elem, struct thread, tid_elem);
+		if (t->tid == tid)
+		{
+			if (t->status != THREAD_DYING)
+				found = t;
+			break;
+		}
 	}
-	return NULL;
+	intr_set_level (old_level);
+	return found;
+}
+
+/* Returns the tid hash bucket of TID. */
+static struct list *
+tid_bucket (tid_t tid)
+{
+	return &tid_hash[(unsigned) tid % TID_HASH_SIZE];
 }
@@ -5,7 +5,9 @@
 #include <list.h>
 #include <stdint.h>
 #include <hash.h>
+#include <schedstat.h>
 #include "threads/synch.h"
+#include "threads/fixed-point.h"
 #include "vm/virtualMemory.h"
 
 /* States in a thread's life cycle. */
@@ -27,10 +29,12 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the multi-level feedback queue scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
 #define STACK_SIZE (8*(1 << 20))
-#ifdef USERPROG
-#define DEAD -2000
-#endif
 
 /* A kernel thread or user process.
 
@@ -98,17 +102,31 @@ struct thread
     int priority;                       /* Priority. */
     int priority_original;              /* Original Priority. */
     struct list_elem allelem;           /* List element for all threads list. */
+    struct list_elem tid_elem;          /* List element for tid hash bucket. */
 		
 		//choi
-		int64_t t_ticks;
+		int64_t t_ticks;										/*Wakeup tick, PIT cycle for short sleeps*/
 
 		//Implements by Vicente Bolea
 		struct lock *lock_waiting; 					/*The lock which block this thread */
-		struct lock *lock_owner;						/*The lock which belong to this thread */
-		struct list poolThread;             /*Threads which donate the priority to it*/
-		bool lock_to_be_open;               /*If the lock has to release any lock*/
+		struct heap held_locks;							/*Locks it holds, by donated priority*/
+		struct heap_elem waiter_elem;				/*Element in lock_waiting's waiters*/
+		unsigned waiter_seq;								/*Keeps waiters of a priority FIFO*/
 		//END implements by Vicente Bolea
 
+    /* Multi-level feedback queue scheduler, owned by thread.c. */
+    int nice;                           /* Niceness. */
+    fixed_t recent_cpu;                 /* CPU time received lately. */
+    bool mlfqs_listed;                  /* In mlfqs_list? */
+    bool mlfqs_dirty;                   /* In dirty_list? */
+    struct list_elem mlfqs_elem;        /* Element in mlfqs_list. */
+    struct list_elem dirty_elem;        /* Element in dirty_list. */
+
+    /* Scheduler accounting, owned by thread.c. */
+    struct sched_thread_stat sched;     /* Run and wait times, switches. */
+    uint64_t sched_stamp;               /* TSC when it started running
+                                           or waiting in a ready list. */
+
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 
@@ -116,22 +134,20 @@ struct thread
 
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory entry ( PAGE TABLE ). */
+    void *user_esp;                     /* User stack pointer at the last
+                                           system call, for stack growth. */
 
 		//For files
-		struct list files;
+		struct file **fds;									/* Open files, indexed by fd */
+		int fd_size;												/* Number of slots in fds */
+		int fd_free;												/* No free fd below this one */
 		struct file *temp_file;
 		char file_name[16];
 
-		//For childrens
-		int child_status;
-		struct list children;
-		
-		//For parent
-		struct semaphore my_sema;
-		struct thread *parent;
-		struct list_elem child_elem;
-		bool is_exit;
-			
+		//For children, see struct child in process.c
+		struct list children;								/* Records of our children */
+		struct child *child;								/* Our record, shared with the parent */
+		int exit_status;										/* Given to exit(), -1 if killed */
 #endif
 
 #ifdef VM
@@ -166,6 +182,7 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -173,17 +190,21 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_change_priority (struct thread *, int);
+void thread_refresh_priority (struct thread *);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
+void thread_get_sched_stat (struct sched_thread_stat *);
+int thread_get_sched_trace (struct sched_event *, int max);
+
 //edited by choi
 bool comp_priority (const struct list_elem *, const struct list_elem *, void *aux);
 
 //edited by Vicente
-void sort_readyList(void);
 bool is_thread_highest(void);
 
 struct thread *tid_to_thread (tid_t);
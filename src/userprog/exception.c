@@ -4,7 +4,10 @@
 #include <debug.h>
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
+#include "userprog/uaccess.h"
+#include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/pte.h"
 #include "threads/thread.h"
 
 #include "vm/virtualMemory.h"
@@ -20,9 +23,12 @@ static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static void bad_access (struct intr_frame *, bool);
 static bool install_page_exception (void *, void *, bool);
 static bool load_page_file (struct page*);
 static bool load_page_mmf (struct page*);
+static bool load_page_zero (struct page*, bool);
+static bool load_page_large (struct page*);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -78,6 +84,7 @@ void
 exception_print_stats (void) 
 {
   printf ("Exception: %lld page faults\n", page_fault_cnt);
+  vmstat_print ();
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -140,9 +147,9 @@ page_fault (struct intr_frame *f)
   bool user;         /* True: access by user, false: access by kernel. */
   void *fault_addr;  /* Fault address. */
 
-	struct thread *t;
 	struct page *pg;
-	struct frame *fr;
+	uint64_t start;
+	void *esp;
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It may point to code or to
@@ -159,45 +166,74 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+	start = vmstat_start ();
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
 	user = (f->error_code & PF_U) != 0;
 	
-	t = thread_current ();
 	pg = pageTable_find (pg_round_down (fault_addr));
 
+	// when the kernel faults on user memory, f->esp is not the
+	// user stack pointer
+	esp = user ? f->esp : thread_current ()->user_esp;
+
+	// first write to the shared zero page (copy on write)
+	if (!not_present && write && pg != NULL && pg->type == zero_page
+			&& pg->frame == NULL) {
+		if (!load_page_zero (pg, true))
+			bad_access (f, user);
+		vmstat_record (VMSTAT_ZERO, start);
+
 	//if it is not valid
-	if (!not_present || !is_user_vaddr (fault_addr) || fault_addr == NULL) {
+	} else if (!is_user_vaddr (fault_addr)) {
 		exit(-1);
 
+	} else if (!not_present || fault_addr == NULL) {
+		bad_access (f, user);
+
 	// if we dont have that page
 	} else if (pg == NULL) {
-			if (fault_addr >= (f->esp - 32) && (PHYS_BASE - pg_round_down (fault_addr)) <= STACK_SIZE ) {
-				if (NULL != (fr = frameTable_alloc ()))
-					pagedir_set_page (t->pagedir, pg_round_down (fault_addr), fr->kaddr, true);	
-				else
+			if (fault_addr >= (esp - 32) && (PHYS_BASE - pg_round_down (fault_addr)) <= STACK_SIZE ) {
+				pg = pageTable_insert_zero (pg_round_down (fault_addr), true);
+				if (!load_page_zero (pg, write))
 					printf("PAGE FAULT COULNT ALLOC\n");
+				vmstat_record (VMSTAT_STACK, start);
 
 			} else {
-				exit(-1);
+				bad_access (f, user);
 			}	
+	// if it is in the compressed cache
+	} else if ((pg->status & compressed) && not_present)	{
+		if (!zswap_load (pg))
+			bad_access (f, user);
+		vmstat_record (VMSTAT_ZSWAP_IN, start);
+
 	// if it is swapped
 	} else if ((pg->status & swapped) && not_present)	{
 		swap_in (pg);
+		vmstat_record (VMSTAT_SWAP_IN, start);
+
+	// bss or stack page which was never written
+	} else if (pg->type == zero_page && pg->status != loaded) {
+		if (!(write && load_page_large (pg)) && !load_page_zero (pg, write))
+			bad_access (f, user);
+		vmstat_record (VMSTAT_ZERO, start);
 
 	// if need to be loaded by lazy loading
 	} else if (pg->type == file_page && pg->status != loaded) {
 		if (!load_page_file (pg))
-			exit(-1);
+			bad_access (f, user);
+		vmstat_record (VMSTAT_FILE, start);
 
 	// if need tobe loaded by lazy loading of mmap
 	} else if (pg->type == mmf_page && pg->status != loaded) { 
 		if (!load_page_mmf (pg))
-			exit(-1);
+			bad_access (f, user);
+		vmstat_record (VMSTAT_MMAP, start);
 	} else if (pg->type == mmf_page && pg->status & loaded) { 
-		exit(-1);
+		bad_access (f, user);
  	}else {
 
 	/* To implement virtual memory, delete the rest of the function
@@ -213,6 +249,23 @@ page_fault (struct intr_frame *f)
 	}
 }
 
+/*
+		An access to an invalid user address: make the accessor of
+		uaccess.h which did it return failure, by resuming at its
+		fixup address, or else kill the process as before
+*/
+static void
+bad_access (struct intr_frame *f, bool user)
+{
+	void *fixup;
+
+	if (user || (fixup = uaccess_fixup ((void *) f->eip)) == NULL)
+		exit(-1);
+
+	f->eip = (void (*) (void)) fixup;
+	f->eax = 0xffffffff;
+}
+
 /*
 		I copied this function from process.c because its needed
 		by stack growth
@@ -239,13 +292,13 @@ load_page_file (struct page *p)
 	uint8_t *kpage;
 
 	p->file = file_reopen (p->file);
-	file_seek (p->file, p->ofs);
 	p->frame = frameTable_alloc ();
 
 	if (NULL == (kpage = p->frame->kaddr))
 		return false;
 
-	if (file_read (p->file, kpage, p->read_bytes) != (int) p->read_bytes) {
+	//straight from the disk into the frame
+	if (file_read_page (p->file, kpage, p->read_bytes, p->ofs) != (int) p->read_bytes) {
 		frameTable_free (p->frame);
 		return false;
 	}
@@ -269,13 +322,13 @@ load_page_mmf (struct page *p)
 	uint8_t *kpage;
 
 	p->file = file_reopen (p->file);
-	file_seek (p->file, p->ofs);
 	p->frame = frameTable_alloc ();
 
 	if (NULL == (kpage = p->frame->kaddr))
 		return false;
 
-	if (file_read (p->file, kpage, p->read_bytes) != (int) p->read_bytes) {
+	//straight from the disk into the frame
+	if (file_read_page (p->file, kpage, p->read_bytes, p->ofs) != (int) p->read_bytes) {
 		frameTable_free (p->frame);
 		return false;
 	}
@@ -290,3 +343,74 @@ load_page_mmf (struct page *p)
 	p->writted = true;
 	return true;
 }
+
+/*
+	Zero pages (bss and stack). A read maps the shared zero page
+	read-only, a write (or the first write after a read) takes a
+	pre-zeroed frame from the pool of the zeroing thread
+*/
+bool
+load_page_zero (struct page *p, bool write)
+{
+	struct thread *t = thread_current ();
+
+	if (!write)
+		return pagedir_set_zero_page (t->pagedir, p->uaddr, frameTable_zero_page ());
+
+	if (!p->writable)
+		return false;
+
+	pagedir_clear_page (t->pagedir, p->uaddr);
+	p->frame = frameTable_alloc_zero ();
+
+	if (!pagedir_set_page (t->pagedir, p->uaddr, p->frame->kaddr, true)) {
+		frameTable_free (p->frame);
+		return false;
+	}
+	p->status = loaded;
+	return true;
+}
+
+/*
+	Large zero regions (a big bss or stack). When every page of the
+	4 MB block around the given page is a writable zero page that was
+	never touched, back the whole block with one 4 MB page, so that it
+	takes one PDE and one TLB entry. The frame table evicts it as 1024
+	normal pages (see frameTable_evict). Return false to fall back to
+	load_page_zero
+*/
+static bool
+load_page_large (struct page *p)
+{
+	struct thread *t = thread_current ();
+	uint8_t *base = (uint8_t*) ((uintptr_t) p->uaddr & ~(PTSPAN - 1));
+	struct page *pg;
+	struct frame *f;
+	size_t i;
+
+	if (!init_large_pages)
+		return false;
+
+	for (i = 0; i < PTSPAN / PGSIZE; i++) {
+		pg = pageTable_find (base + i * PGSIZE);
+		if (pg == NULL || pg->type != zero_page || pg->status != 0
+				|| !pg->writable || pagedir_get_page (t->pagedir, pg->uaddr) != NULL)
+			return false;
+	}
+
+	if (NULL == (f = frameTable_alloc_large ()))
+		return false;
+
+	if (!pagedir_set_large_page (t->pagedir, base, f->kaddr, true)) {
+		palloc_free_multiple (f->kaddr, PTSPAN / PGSIZE);
+		frameTable_free (f);
+		return false;
+	}
+
+	for (i = 0; i < PTSPAN / PGSIZE; i++) {
+		pg = pageTable_find (base + i * PGSIZE);
+		pg->frame = f;
+		pg->status = loaded;
+	}
+	return true;
+}
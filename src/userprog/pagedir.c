@@ -7,8 +7,15 @@
 #include "threads/palloc.h"
 #include "vm/virtualMemory.h"
 
+/* Largest number of pages pagedir_clear_pages() invalidates
+   one at a time before it flushes the whole TLB instead. */
+#define PAGEDIR_FLUSH_MAX 32
+
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
+static bool split_large_page (uint32_t *pd, uint32_t *pde);
+static uint32_t *lookup_bits (uint32_t *pd, const void *vaddr);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -35,13 +42,15 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != init_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
+    if (pde_is_large (*pde))
+      palloc_free_multiple (pte_get_page (*pde), PTSPAN / PGSIZE);
+    else if (*pde & PTE_P) 
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
         
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
+          if ((*pte & PTE_P) && !(*pte & PTE_ZERO))
             palloc_free_page (pte_get_page (*pte));
         palloc_free_page (pt);
       }
@@ -65,8 +74,12 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
   ASSERT (!create || is_user_vaddr (vaddr));
 
   /* Check for a page table for VADDR.
-     If one is missing, create one if requested. */
+     If one is missing, create one if requested.
+     A 4 MB page falls back to a page table of 4 kB pages, so
+     that the caller gets a PTE it can change on its own. */
   pde = pd + pd_no (vaddr);
+  if (pde_is_large (*pde) && !split_large_page (pd, pde))
+    return NULL;
   if (*pde == 0) 
     {
       if (create)
@@ -132,6 +145,80 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     return false;
 }
 
+/* Maps user virtual page UPAGE in PD read-only to the shared
+   zero page ZPAGE.  The mapping is tagged with PTE_ZERO so that
+   pagedir_destroy() never frees the shared page, and it does not
+   take a frame table slot.  The first write to UPAGE faults and
+   replaces the mapping with a private frame.
+   Returns true if successful, false if memory allocation
+   failed. */
+bool
+pagedir_set_zero_page (uint32_t *pd, void *upage, void *zpage)
+{
+  uint32_t *pte;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (pd != init_page_dir);
+
+  pte = lookup_page (pd, upage, true);
+  if (pte == NULL)
+    return false;
+
+  ASSERT ((*pte & PTE_P) == 0);
+  *pte = pte_create_user (zpage, false) | PTE_ZERO;
+  return true;
+}
+
+/* Maps the PTSPAN (4 MB) bytes of user virtual memory starting
+   at UPAGE to the physically contiguous pages starting at KPAGE
+   with a single 4 MB page.  Both must be 4 MB aligned, and KPAGE
+   should be obtained from the user pool with
+   frameTable_alloc_large().  If WRITABLE is true, the mapping is
+   read/write; otherwise it is read-only.
+   The mapping falls back to 4 kB pages as soon as one of its
+   pages is changed on its own, see lookup_page(), or when it is
+   evicted, see pagedir_split_large_page().
+   Returns false if 4 MB pages are not enabled or if part of the
+   range is already mapped. */
+bool
+pagedir_set_large_page (uint32_t *pd, void *upage, void *kpage,
+                        bool writable)
+{
+  uint32_t *pde;
+  struct frame *f;
+
+  ASSERT ((uintptr_t) upage % PTSPAN == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (pd != init_page_dir);
+
+  if (!init_large_pages)
+    return false;
+
+  pde = pd + pd_no (upage);
+  if (*pde != 0)
+    return false;
+
+  *pde = pde_create_large (kpage, writable, true);
+  f = frameTable_find_by_kaddr (kpage);
+  f->page = pde;
+  f->uaddr = upage;
+  return true;
+}
+
+/* Makes the 4 MB page that maps user virtual address UPAGE in
+   PD, if any, a page table of 4 kB pages with the same frames
+   and bits.  Returns false if memory allocation fails. */
+bool
+pagedir_split_large_page (uint32_t *pd, const void *upage)
+{
+  uint32_t *pde = pd + pd_no (upage);
+
+  ASSERT (is_user_vaddr (upage));
+
+  return !pde_is_large (*pde) || split_large_page (pd, pde);
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -142,6 +229,11 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
   uint32_t *pte;
 
   ASSERT (is_user_vaddr (uaddr));
+
+  /* 4 MB pages need no page table walk. */
+  if (pde_is_large (pd[pd_no (uaddr)]))
+    return (pte_get_page (pd[pd_no (uaddr)])
+            + ((uintptr_t) uaddr & (PTSPAN - 1)));
   
   pte = lookup_page (pd, uaddr, false);
   if (pte != NULL && (*pte & PTE_P) != 0)
@@ -166,18 +258,53 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
+    }
+}
+
+/* Marks the CNT user virtual pages starting at UPAGE "not
+   present" in page directory PD, like pagedir_clear_page().
+   Invalidating more than PAGEDIR_FLUSH_MAX pages one by one costs
+   more than refilling the TLB, so then the whole TLB is flushed
+   once at the end instead. */
+void
+pagedir_clear_pages (uint32_t *pd, void *upage, size_t cnt) 
+{
+  uint8_t *page = upage;
+  bool flush = false;
+  size_t i;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  for (i = 0; i < cnt; i++, page += PGSIZE)
+    {
+      uint32_t *pte;
+
+      ASSERT (is_user_vaddr (page));
+      pte = lookup_page (pd, page, false);
+      if (pte != NULL && (*pte & PTE_P) != 0)
+        {
+          *pte &= ~PTE_P;
+          if (cnt <= PAGEDIR_FLUSH_MAX)
+            invalidate_page (pd, page);
+          else
+            flush = true;
+        }
     }
+  if (flush)
+    invalidate_pagedir (pd);
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
-   Returns false if PD contains no PTE for VPAGE. */
+   Returns false if PD contains no PTE for VPAGE.
+   The bit of a 4 MB page is shared by all of its pages, and so
+   are the accessed bit and the setters below. */
 bool
 pagedir_is_dirty (uint32_t *pd, const void *vpage) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
+  uint32_t *pte = lookup_bits (pd, vpage);
   return pte != NULL && (*pte & PTE_D) != 0;
 }
 
@@ -186,7 +313,7 @@ pagedir_is_dirty (uint32_t *pd, const void *vpage)
 void
 pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
+  uint32_t *pte = lookup_bits (pd, vpage);
   if (pte != NULL) 
     {
       if (dirty)
@@ -194,7 +321,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -206,7 +333,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
 bool
 pagedir_is_accessed (uint32_t *pd, const void *vpage) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
+  uint32_t *pte = lookup_bits (pd, vpage);
   return pte != NULL && (*pte & PTE_A) != 0;
 }
 
@@ -215,15 +342,15 @@ pagedir_is_accessed (uint32_t *pd, const void *vpage)
 void
 pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
+  uint32_t *pte = lookup_bits (pd, vpage);
   if (pte != NULL) 
     {
       if (accessed)
         *pte |= PTE_A;
       else 
         {
-          *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          *pte &= ~(uint32_t) PTE_A;
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -257,6 +384,43 @@ active_pd (void)
   return ptov (pd);
 }
 
+/* Returns the entry that holds the accessed and dirty bits of
+   virtual address VADDR in PD: the PDE of a 4 MB page, which is
+   left as it is, or else the PTE, or a null pointer if there is
+   none. */
+static uint32_t *
+lookup_bits (uint32_t *pd, const void *vaddr) 
+{
+  uint32_t *pde = pd + pd_no (vaddr);
+
+  if (pde_is_large (*pde))
+    return pde;
+  return lookup_page (pd, vaddr, false);
+}
+
+/* Replaces the 4 MB page mapped by *PDE in PD by a page table
+   that maps the same memory with 4 kB pages, keeping the
+   mapping's permissions and accessed and dirty bits.
+   Returns false if memory allocation fails. */
+static bool
+split_large_page (uint32_t *pd, uint32_t *pde) 
+{
+  uint8_t *page = pte_get_page (*pde);
+  uint32_t flags = *pde & (PTE_P | PTE_W | PTE_U | PTE_A | PTE_D);
+  uint32_t *pt;
+  size_t i;
+
+  pt = palloc_get_page (0);
+  if (pt == NULL)
+    return false;
+
+  for (i = 0; i < PTSPAN / PGSIZE; i++)
+    pt[i] = vtop (page + i * PGSIZE) | flags;
+  *pde = pde_create (pt);
+  invalidate_page (pd, (void *) ((pde - pd) << PDSHIFT));
+  return true;
+}
+
 /* Seom page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
    table.  When this happens, we have to "invalidate" the TLB by
@@ -264,7 +428,9 @@ active_pd (void)
 
    This function invalidates the TLB if PD is the active page
    directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   the TLB, so there is no need to invalidate anything.)
+   Single page changes use invalidate_page() instead; this is
+   only for bulk changes. */
 static void
 invalidate_pagedir (uint32_t *pd) 
 {
@@ -275,3 +441,14 @@ invalidate_pagedir (uint32_t *pd)
       pagedir_activate (pd);
     } 
 }
+
+/* Drops the TLB entry for virtual address VADDR if PD is the
+   active page directory, leaving the rest of the TLB alone.  This
+   is much cheaper than invalidate_pagedir() when only one PTE
+   changed.  See [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vaddr) 
+{
+  if (active_pd () == pd)
+    asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+}
@@ -8,10 +8,12 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
@@ -23,7 +25,36 @@
 #include "vm/virtualMemory.h"
 
 static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static bool load (struct file *, void (**eip) (void), void **esp);
+static bool setup_args (const char *cmdline, void **esp);
+
+/* What a parent knows about one of its children, in the
+   parent's `children' list.  The child and the parent each hold
+   a reference, and whichever lets go last frees it, so a child
+   that exits does not wait for its parent and a parent that
+   exits does not wait for its children. */
+struct child
+  {
+    tid_t tid;                  /* Child's thread id. */
+    int exit_status;            /* Valid once exit_sema is up. */
+    bool loaded;                /* Valid once load_sema is up. */
+    int ref_cnt;                /* 2 while both hold it, then 1. */
+    struct semaphore load_sema; /* Up when the child has loaded. */
+    struct semaphore exit_sema; /* Up when the child has exited. */
+    struct list_elem elem;      /* Element in parent's `children'. */
+  };
+
+static struct child *child_create (void);
+static void child_release (struct child *);
+
+/* What process_execute() hands to start_process(), at the start
+   of the page that also holds the command line. */
+struct exec_args
+  {
+    struct file *file;          /* Executable, open and write-denied. */
+    struct child *child;        /* Record shared with the parent. */
+    char cmdline[];             /* Command line. */
+  };
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -32,60 +63,67 @@ static bool load (const char *cmdline, void (**eip) (void), void **esp);
 tid_t
 process_execute (const char *file_name) 
 {
-  char *fn_copy,*fn_copy2, *tmp_name, *dumb;
+	struct exec_args *args;
+	struct child *c;
+	char name[NAME_MAX + 1];
+	size_t len;
   tid_t tid;
 
+	/* The program name is the first word of FILE_NAME. */
+	while (*file_name == ' ')
+		file_name++;
+	len = strcspn (file_name, " ");
+	if (len == 0 || len > NAME_MAX)
+		return TID_ERROR;
+	memcpy (name, file_name, len);
+	name[len] = '\0';
+
   /* Make a copy of FILE_NAME.
-     Otherwise there's a race between the caller and load(). */
-  if ( NULL == (fn_copy = palloc_get_page (0)))
+     Otherwise there's a race between the caller and load().
+		 The executable is opened here once, and stays open, with
+		 writes denied, until the new process exits. */
+  if ( NULL == (args = palloc_get_page (0)))
     return TID_ERROR;
-	
-	fn_copy2 = palloc_get_page (0);
-  strlcpy (fn_copy, file_name, PGSIZE);
-	strlcpy (fn_copy2, file_name, PGSIZE);
-	tmp_name = malloc(strlen(file_name)+1);
-  memcpy(tmp_name, file_name, strlen(file_name)+1);
-	file_name = strtok_r( tmp_name, " ", &dumb);
-
-	struct file *f;
-	if (NULL == (f = filesys_open(tmp_name))){
-		return TID_ERROR;
-	} else
-		file_close(f);
+  strlcpy (args->cmdline, file_name, PGSIZE - sizeof *args);
+
+	args->file = filesys_open (name);
+	c = args->child = child_create ();
+	if (args->file == NULL || c == NULL)
+		goto error;
+	file_deny_write (args->file);
 	
   /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (tmp_name, PRI_DEFAULT, start_process, fn_copy);
-	fn_copy = fn_copy2;
-	
-	struct thread *my_thread = tid_to_thread(tid);
-	sema_down(&my_thread->my_sema);
-	while (my_thread->status == THREAD_BLOCKED)
-		thread_unblock (my_thread);
-	if (my_thread->child_status == -1)
-		process_wait (my_thread->tid);
-	
+  tid = thread_create (name, PRI_DEFAULT, start_process, args);
   if (tid == TID_ERROR)
-    palloc_free_page (fn_copy); 
-
-	palloc_free_page (fn_copy2);
+		goto error;
+
+	/* Wait until it has loaded, ARGS is its own from now on. */
+	c->tid = tid;
+	list_push_back (&thread_current ()->children, &c->elem);
+	sema_down (&c->load_sema);
+	if (!c->loaded) {
+		list_remove (&c->elem);
+		child_release (c);
+		return TID_ERROR;
+	}
   return tid;
-	
+
+error:
+	file_close (args->file);
+	free (c);
+	palloc_free_page (args);
+	return TID_ERROR;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *args_)
 {
-	char *file_name = file_name_;
+	struct exec_args *args = args_;
   struct intr_frame if_;
-  int argc, i, *all_arguments;
-	size_t fn_length;
   struct thread *t;
-  char *token, *dumb;
   bool success;
-  void *start;
-
 
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
@@ -94,65 +132,20 @@ start_process (void *file_name_)
   if_.eflags = FLAG_IF | FLAG_MBS;
   
   t = thread_current ();
-  argc = 0;
-  if (NULL == (all_arguments = malloc (32 * sizeof (int)))) {
-			sema_up(&t->my_sema);
-      thread_exit ();
-	}
-
-  fn_length= strlen (file_name);
-  all_arguments[0] = 0;
-	token = strtok_r (file_name, " ", &dumb);
-	while ( token != NULL) {
-		while (*(dumb) == ' ')
-			++dumb;
-
-		all_arguments[++argc] = dumb - file_name;
-		token = strtok_r (NULL, " ", &dumb);
-	}
-
+	t->child = args->child;
 	hash_init (&t->pageTable, page_hash, comp_va_page, NULL);
 
-	if( (success = load (file_name, &if_.eip, &if_.esp)))
-	{
-		t->temp_file = filesys_open (file_name);
-		file_deny_write (t->temp_file);
-		if_.esp -= fn_length+ 1;
-		start = if_.esp;
-		memcpy (if_.esp, file_name, fn_length + 1);
-		if_.esp -= 4 - (fn_length + 1) % 4; 
-		if_.esp -= 4;
-		*(int *)(if_.esp) = 0;
-
-		for (i = argc - 1; i >= 0; --i)
-		{
-			if_.esp -= 4;
-			*(void **)(if_.esp) = start + all_arguments[i];
-		}
+	success = load (args->file, &if_.eip, &if_.esp)
+		&& setup_args (args->cmdline, &if_.esp);
 
-		if_.esp -= 4;
-		*(char **)(if_.esp) = (if_.esp + 4);
-		if_.esp -= 4;
-		*(int *)(if_.esp) = argc;
-		if_.esp -= 4;
-		*(int *)(if_.esp) = 0;
-
-		sema_up(&t->my_sema);
-		intr_disable ();
-		thread_yield();
-		intr_enable ();
-
-	} else {
-		free (all_arguments);
-		sema_up(&t->my_sema);
-		intr_disable ();
-		thread_block ();
-		intr_enable ();
-		thread_exit ();
-	}
+	//the lazy loaded pages read from it until we exit
+	t->temp_file = args->file;
+	palloc_free_page (args);
 
-	free (all_arguments);
-	palloc_free_page (file_name);
+	t->child->loaded = success;
+	sema_up (&t->child->load_sema);
+	if (!success)
+		thread_exit ();
 
 	/* Start the user process by simulating a return from an
 		 interrupt, implemented by intr_exit (in
@@ -164,30 +157,102 @@ start_process (void *file_name_)
 	NOT_REACHED ();
 }
 
-int
-process_wait (tid_t child_tid)
+/* Builds the arguments of main() for CMDLINE on the user stack,
+	 below *ESP, and moves *ESP below them.  The words of CMDLINE
+	 are split in place in the copy on the stack.  Returns false
+	 if they do not fit in the first stack page. */
+static bool
+setup_args (const char *cmdline, void **esp)
 {
-	struct thread *t;
-	int status = 0;
+	size_t len = strlen (cmdline) + 1;
+	char *copy, *token, *save, *p;
+	char **argv;
+	int argc = 0, i;
 
-	t = tid_to_thread (child_tid);
-	if (t == NULL || t->status == THREAD_DYING || t->child_status == DEAD)
-	{
-		return -1;
+	if (len > PGSIZE / 2)
+		return false;
+	copy = (char *) *esp - len;
+	strlcpy (copy, cmdline, len);
+
+	for (token = strtok_r (copy, " ", &save); token != NULL;
+			token = strtok_r (NULL, " ", &save))
+		argc++;
+
+	/* argv[] with its null sentinel, then argv, argc and a fake
+		 return address. */
+	argv = (char **) ((uintptr_t) copy & ~3) - (argc + 1);
+	if ((uint8_t *) (argv - 3) < (uint8_t *) PHYS_BASE - PGSIZE)
+		return false;
+
+	for (i = 0, p = copy; i < argc; i++) {
+		while (*p == ' ')
+			p++;
+		argv[i] = p;
+		p += strlen (p) + 1;
 	}
-	if (t->child_status != DEAD && t->child_status != 0)
-	{
-		status = t->child_status;
-		t->child_status = DEAD;
-		return status;
+	argv[argc] = NULL;
+
+	*(char ***) (argv - 1) = argv;
+	*(int *) (argv - 2) = argc;
+	*(int *) (argv - 3) = 0;
+	*esp = argv - 3;
+	return true;
+}
+
+/* Allocates the record of a child, with both references
+	 taken, or returns a null pointer if memory is short. */
+static struct child *
+child_create (void)
+{
+	struct child *c = malloc (sizeof *c);
+
+	if (c != NULL) {
+		c->tid = TID_ERROR;
+		c->exit_status = -1;
+		c->loaded = false;
+		c->ref_cnt = 2;
+		sema_init (&c->load_sema, 0);
+		sema_init (&c->exit_sema, 0);
+	}
+	return c;
+}
+
+/* Drops one reference to C, and frees it with the last one. */
+static void
+child_release (struct child *c)
+{
+	enum intr_level old_level;
+	bool last;
+
+	old_level = intr_disable ();
+	last = --c->ref_cnt == 0;
+	intr_set_level (old_level);
+	if (last)
+		free (c);
+}
+
+/* Waits for the child CHILD_TID of the current process to exit
+	 and returns its exit status, or -1 if it is not a child of
+	 ours or was already waited for. */
+int
+process_wait (tid_t child_tid)
+{
+	struct list *children = &thread_current ()->children;
+	struct list_elem *e;
+	struct child *c;
+	int status;
+
+	for (e = list_begin (children); e != list_end (children); e = list_next (e)) {
+		c = list_entry (e, struct child, elem);
+		if (c->tid == child_tid) {
+			list_remove (&c->elem);
+			sema_down (&c->exit_sema);
+			status = c->exit_status;
+			child_release (c);
+			return status;
+		}
 	}
-	sema_down(&t->my_sema);
-	status = t->child_status;
-	printf ("%s: exit(%d)\n", t->name, t->child_status);
-	if (t->status == THREAD_BLOCKED)
-		thread_unblock (t);
-	t->child_status = DEAD;
-	return status;
+	return -1;
 }
 
 /* Free the current process's resources. */
@@ -195,30 +260,31 @@ void
 process_exit (void)
 {
 	struct thread *cur = thread_current ();
+	struct child *c = cur->child;
 	uint32_t *pd;
 
-	// choi
-	while (!list_empty (&cur->my_sema.waiters))
-		sema_up(&cur->my_sema);
+	if (c != NULL && c->loaded)
+		printf ("%s: exit(%d)\n", cur->name, cur->exit_status);
 
+	//children which are still running free their records themselves
+	while (!list_empty (&cur->children))
+		child_release (list_entry (list_pop_front (&cur->children),
+					struct child, elem));
 
+	fd_close_all ();
 	hash_destroy (&cur->pageTable, page_hash_delete);
-	cur->is_exit = true;
-	if (cur->parent) {
-
-		intr_disable ();
-		thread_block ();
-		intr_enable ();
-	}
 
-	if (cur->temp_file != NULL) 
-		file_allow_write(cur->temp_file);
+	//allows writes to the executable again
+	file_close (cur->temp_file);
+	cur->temp_file = NULL;
 
 	/* Destroy the current process's page directory and switch back
 		 to the kernel-only page directory. */
 	pd = cur->pagedir;
 	if (pd != NULL) 
 	{
+		frameTable_free_thread (cur->tid);
+
 		/* Correct ordering here is crucial.  We must set
 			 cur->pagedir to NULL before switching page directories,
 			 so that a timer interrupt can't switch back to the
@@ -233,6 +299,13 @@ process_exit (void)
 		pagedir_destroy (pd);
 	}
 
+	//the parent can go on, our thread is freed as soon as we stop
+	if (c != NULL) {
+		c->exit_status = cur->exit_status;
+		sema_up (&c->exit_sema);
+		child_release (c);
+		cur->child = NULL;
+	}
 }
 
 /* Sets up the CPU for running user code in the current
@@ -314,127 +387,192 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
+/* A loadable segment, see load_segment(). */
+struct exec_segment
+{
+	uint32_t file_page;           /* Page-aligned offset in the file. */
+	uint32_t mem_page;            /* Page-aligned user address. */
+	uint32_t read_bytes;          /* Bytes read from the file. */
+	uint32_t zero_bytes;          /* Zeroed bytes that follow. */
+	bool writable;                /* Writable by the process? */
+};
+
+/* The program headers of an executable, read and checked once
+	 and then cached on its inode for as long as the inode stays
+	 open and unmodified, so that running the same program again,
+	 as exec-heavy workloads do, skips them. */
+struct exec_image
+{
+	Elf32_Addr entry;             /* Entry point. */
+	int seg_cnt;                  /* Number of loadable segments. */
+	struct exec_segment segs[];   /* Loadable segments. */
+};
+
 static bool setup_stack (void **esp);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes,
 		bool writable);
+static const struct exec_image *exec_image_get (struct file *);
+static struct exec_image *exec_image_parse (struct file *);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
+/* Loads an ELF executable from FILE, which must stay open with
+	 writes denied, into the current thread.
 	 Stores the executable's entry point into *EIP
 	 and its initial stack pointer into *ESP.
 	 Returns true if successful, false otherwise. */
 bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+load (struct file *file, void (**eip) (void), void **esp) 
 {
 	struct thread *t = thread_current ();
-	struct Elf32_Ehdr ehdr;
-	struct file *file = NULL;
-	off_t file_ofs;
-	bool success = false;
+	const struct exec_image *img;
+	const struct exec_segment *seg;
 	int i;
 
 	/* Allocate and activate page directory. */
 	t->pagedir = pagedir_create ();
 	if (t->pagedir == NULL) 
-		goto done;
+		return false;
 	process_activate ();
 
-	/* Open executable file. */
-	file = filesys_open (file_name);
-	if (file == NULL) 
+	/* Read and verify executable header and program headers. */
+	if (NULL == (img = exec_image_get (file)))
 	{
-		printf ("load: %s: open failed\n", file_name);
-		goto done; 
+		printf ("load: %s: error loading executable\n", t->name);
+		return false;
 	}
 
+	for (i = 0; i < img->seg_cnt; i++)
+	{
+		seg = &img->segs[i];
+		if (!load_segment (file, seg->file_page, (void *) seg->mem_page,
+					seg->read_bytes, seg->zero_bytes, seg->writable))
+			return false;
+	}
+
+	/* Set up stack. */
+	if (!setup_stack (esp))
+		return false;
+
+	/* Start address. */
+	*eip = (void (*) (void)) img->entry;
+	return true;
+}
+
+/* Returns the parsed program headers of FILE, from the cache of
+	 its inode if another process ran it since it was opened or
+	 last written to.  Returns a null pointer if FILE is not a
+	 valid executable. */
+static const struct exec_image *
+exec_image_get (struct file *file)
+{
+	struct inode *inode = file_get_inode (file);
+	struct exec_image *img, *cached;
+
+	if (NULL != (cached = inode_get_cache (inode)))
+		return cached;
+	if (NULL == (img = exec_image_parse (file)))
+		return NULL;
+
+	//someone else may have parsed it meanwhile
+	cached = inode_set_cache (inode, img, free);
+	if (cached != img)
+		free (img);
+	return cached;
+}
+
+/* Reads and checks the executable header and the program headers
+	 of FILE, all of them with one read, and returns the loadable
+	 segments, or a null pointer if FILE is not a valid executable
+	 or memory is short. */
+static struct exec_image *
+exec_image_parse (struct file *file)
+{
+	struct Elf32_Ehdr ehdr;
+	struct Elf32_Phdr *phdrs, *phdr;
+	struct exec_image *img = NULL;
+	struct exec_segment *seg;
+	off_t size;
+	int i, seg_cnt = 0;
+
 	/* Read and verify executable header. */
-	if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+	if (file_read_at (file, &ehdr, sizeof ehdr, 0) != sizeof ehdr
 			|| memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
 			|| ehdr.e_type != 2
 			|| ehdr.e_machine != 3
 			|| ehdr.e_version != 1
 			|| ehdr.e_phentsize != sizeof (struct Elf32_Phdr)
+			|| ehdr.e_phnum == 0
 			|| ehdr.e_phnum > 1024) 
-	{
-		printf ("load: %s: error loading executable\n", file_name);
-		goto done; 
-	}
+		return NULL;
 
 	/* Read program headers. */
-	file_ofs = ehdr.e_phoff;
-	for (i = 0; i < ehdr.e_phnum; i++) 
-	{
-		struct Elf32_Phdr phdr;
-
-		if (file_ofs < 0 || file_ofs > file_length (file))
-			goto done;
-		file_seek (file, file_ofs);
+	size = ehdr.e_phnum * sizeof *phdrs;
+	if (ehdr.e_phoff > (Elf32_Off) file_length (file)
+			|| NULL == (phdrs = malloc (size)))
+		return NULL;
+	if (file_read_at (file, phdrs, size, ehdr.e_phoff) != size)
+		goto done;
 
-		if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-			goto done;
-		file_ofs += sizeof phdr;
-		switch (phdr.p_type) 
+	for (i = 0; i < ehdr.e_phnum; i++) 
+		switch (phdrs[i].p_type) 
 		{
-			case PT_NULL:
-			case PT_NOTE:
-			case PT_PHDR:
-			case PT_STACK:
-			default:
-				/* Ignore this segment. */
-				break;
 			case PT_DYNAMIC:
 			case PT_INTERP:
 			case PT_SHLIB:
 				goto done;
 			case PT_LOAD:
-				if (validate_segment (&phdr, file)) 
-				{
-					bool writable = (phdr.p_flags & PF_W) != 0;
-					uint32_t file_page = phdr.p_offset & ~PGMASK;
-					uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
-					uint32_t page_offset = phdr.p_vaddr & PGMASK;
-					uint32_t read_bytes, zero_bytes;
-					if (phdr.p_filesz > 0)
-					{
-						/* Normal segment.
-							 Read initial part from disk and zero the rest. */
-						read_bytes = page_offset + phdr.p_filesz;
-						zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-								- read_bytes);
-					}
-					else 
-					{
-						/* Entirely zero.
-							 Don't read anything from disk. */
-						read_bytes = 0;
-						zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
-					}
-					if (!load_segment (file, file_page, (void *) mem_page,
-								read_bytes, zero_bytes, writable))
-						goto done;
-				}
-				else
+				if (!validate_segment (&phdrs[i], file))
 					goto done;
+				seg_cnt++;
+				break;
+			default:
+				/* Ignore this segment. */
 				break;
 		}
-	}
 
-	/* Set up stack. */
-	if (!setup_stack (esp))
+	img = malloc (sizeof *img + seg_cnt * sizeof *img->segs);
+	if (img == NULL)
 		goto done;
+	img->entry = ehdr.e_entry;
+	img->seg_cnt = seg_cnt;
 
-	/* Start address. */
-	*eip = (void (*) (void)) ehdr.e_entry;
+	seg = img->segs;
+	for (i = 0; i < ehdr.e_phnum; i++) 
+	{
+		uint32_t page_offset;
 
-	success = true;
+		phdr = &phdrs[i];
+		if (phdr->p_type != PT_LOAD)
+			continue;
+
+		page_offset = phdr->p_vaddr & PGMASK;
+		seg->writable = (phdr->p_flags & PF_W) != 0;
+		seg->file_page = phdr->p_offset & ~PGMASK;
+		seg->mem_page = phdr->p_vaddr & ~PGMASK;
+		if (phdr->p_filesz > 0)
+		{
+			/* Normal segment.
+				 Read initial part from disk and zero the rest. */
+			seg->read_bytes = page_offset + phdr->p_filesz;
+			seg->zero_bytes = (ROUND_UP (page_offset + phdr->p_memsz, PGSIZE)
+					- seg->read_bytes);
+		}
+		else 
+		{
+			/* Entirely zero.
+				 Don't read anything from disk. */
+			seg->read_bytes = 0;
+			seg->zero_bytes = ROUND_UP (page_offset + phdr->p_memsz, PGSIZE);
+		}
+		seg++;
+	}
 
 done:
-	/* We arrive here whether the load is successful or not. */
-	file_close (file);
-	return success;
+	free (phdrs);
+	return img;
 }
-
+
 /* load() helpers. */
 
 static bool install_page (void *upage, void *kpage, bool writable);
@@ -515,8 +653,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		//insert an empty page to be loaded by lazy loading
-		pageTable_insert_file (upage, file, ofs, page_read_bytes, page_zero_bytes, writable);
+		//insert an empty page to be loaded by lazy loading,
+		//pages without data (bss) share the zero page
+		if (page_read_bytes == 0)
+			pageTable_insert_zero (upage, writable);
+		else
+			pageTable_insert_file (upage, file, ofs, page_read_bytes, page_zero_bytes, writable);
 			
 		/* Advance. */
 		read_bytes -= page_read_bytes;
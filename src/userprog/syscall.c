@@ -4,15 +4,19 @@
 #include <stdio.h>
 #include <string.h>
 #include <syscall-nr.h>
+#include <ring.h>
+#include <uio.h>
 
 //Vicente's implementation
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
+#include "userprog/uaccess.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
 #include "vm/virtualMemory.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -25,22 +29,20 @@
 
 typedef int pid_t;
 typedef int mapid_t;
-struct file_attr { 
-	int fd;											/* 	File descriptor */
-	int holder; 								/* 	tid_t of the holder thread */
-	struct file *file;					/* 	File binded to this structure */
-	struct list_elem elem;			/* 	element for the list */
-};
 
-struct list opened_files;			/*	list of opened files */
-struct lock my_lock; 					/* 	lock required for synchronize */
+#define FD_MIN 2							/*	first fd after stdin and stdout */
+#define FD_TABLE_INIT 16			/*	initial size of a fd table */
+#define IO_WINDOW (16 * PGSIZE)	/*	most user memory pinned by read or write */
+
 
 
 /////////////////////////////////////////////////////////////////////////////
 // DECLARING STATICS (PRIVATE) FUNCTIONS																	///
 /////////////////////////////////////////////////////////////////////////////
 
-static struct file_attr* fdtofile(int);
+static int fd_alloc (struct file *);
+static struct file* fdtofile (int);
+static struct file* fd_remove (int);
 
 
 //This variables are needed for mmap
@@ -48,13 +50,6 @@ static int fd_by_mmap;
 static void* last_mmap = NULL;
 static struct page* last_page = NULL;
 
-uint32_t* my_esp;
-
-static inline int get_new_fd (void) 
-{ 
-	static int current_fd = 2;				/* 	last assignated fd	*/	
-	return ++current_fd; 
-}
 
 static void syscall_handler (struct intr_frame *);
 static void halt (void);
@@ -71,42 +66,127 @@ static unsigned tell (int);
 static void close (int);
 static mapid_t mmap (int, void*);
 static void munmap (mapid_t);
+static bool mmap_overlaps (void *, int);
+static bool vmstat (struct vmstat *);
+static int schedstat (struct sched_thread_stat *, struct sched_event *, int);
+static int submit (struct ring *, unsigned);
+static int submit_one (const struct ring_sqe *);
+static int pread (int, void *, unsigned, unsigned);
+static int pwrite (int, const void *, unsigned, unsigned);
+static int readv (int, const struct iovec *, int);
+static int writev (int, const struct iovec *, int);
+static int file_io (struct file *, uint8_t *, unsigned, off_t, bool);
+static void mmf_forget_writes (int);
+static int32_t arg4 (struct intr_frame *);
 
 /////////////////////////////////////////////////////////////////////////////
 // IMPLEMENTATION OF FUNCTIONS																						///
 /////////////////////////////////////////////////////////////////////////////
 
-/* IS valid? */ 
-inline bool
-is_valid_usrptr (const void *usrptr)
+/*
+	True if one of the pages of the LENGTH bytes at ADDR is not user
+	memory or is already in the supplemental page table, which also
+	knows the lazy, swapped and compressed pages
+*/
+static bool
+mmap_overlaps (void *addr, int length)
+{
+	uint8_t *upage;
+
+	for (upage = addr; upage < (uint8_t *) addr + length; upage += PGSIZE)
+		if (!is_user_vaddr (upage) || pageTable_find (upage) != NULL)
+			return true;
+	return false;
+}
+
+/*
+	Give the file the lowest free fd of the current process,
+	growing its table when it is full. Return -1 if there is
+	no memory left
+*/
+static int
+fd_alloc (struct file *file)
 {
-	if ((usrptr != NULL) && (is_user_vaddr (usrptr) == true))
-		return (pagedir_get_page(thread_current()->pagedir, usrptr) != NULL);
-	else
-		return false;
+	struct thread *t = thread_current ();
+	struct file **fds;
+	int fd, size;
+
+	for (fd = t->fd_free > FD_MIN ? t->fd_free : FD_MIN; fd < t->fd_size; fd++)
+		if (t->fds[fd] == NULL)
+			break;
+
+	if (fd == t->fd_size) {
+		size = t->fd_size > 0 ? t->fd_size * 2 : FD_TABLE_INIT;
+		if (NULL == (fds = realloc (t->fds, size * sizeof *fds)))
+			return -1;
+		memset (fds + t->fd_size, 0, (size - t->fd_size) * sizeof *fds);
+		t->fds = fds;
+		t->fd_size = size;
+	}
+
+	t->fds[fd] = file;
+	t->fd_free = fd + 1;
+	return fd;
 }
 
 /*
-	This function will return the file_attr for a given fd
-	Will iterate over the list of files opened
+	This function will return the file for a given fd of the
+	current process, NULL if it is not open
 */
-static struct file_attr*
+static struct file*
 fdtofile (int fd) 
 {	
-	struct list_elem* node = list_tail(&opened_files);
-	for (; node != list_head(&opened_files); node = list_prev(node))
-		if (list_entry(node, struct file_attr, elem)->fd == fd)
-			return list_entry(node, struct file_attr, elem);
+	struct thread *t = thread_current ();
+
+	if (fd < FD_MIN || fd >= t->fd_size)
+		return NULL;
+	return t->fds[fd];
+}
+
+/*
+	Take the given fd out of the table of the current process and
+	return its file, NULL if it is not open
+*/
+static struct file*
+fd_remove (int fd)
+{
+	struct thread *t = thread_current ();
+	struct file *f = fdtofile (fd);
 
-	return NULL;
+	if (f != NULL) {
+		t->fds[fd] = NULL;
+		if (fd < t->fd_free)
+			t->fd_free = fd;
+	}
+	return f;
+}
+
+/*
+	Close all the files the current process left open, and free
+	its fd table. Called when the process exits
+*/
+void
+fd_close_all (void)
+{
+	struct thread *t = thread_current ();
+	int fd;
+
+	if (t->fds == NULL)
+		return;
+
+	for (fd = FD_MIN; fd < t->fd_size; fd++)
+		if (t->fds[fd] != NULL)
+			file_close(t->fds[fd]);
+
+	free (t->fds);
+	t->fds = NULL;
+	t->fd_size = t->fd_free = 0;
 }
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-	lock_init(&my_lock);
-	list_init(&opened_files);
 }
 
 /* 
@@ -116,12 +196,13 @@ static void
 syscall_handler (struct intr_frame *f UNUSED) 
 {
 		
-	int32_t *esp = f->esp;
-	my_esp = f->esp;
+	int32_t args[4];
+	int32_t *esp = args;
 	uint32_t *eax = &(f->eax);
 
-	if ( 	!is_valid_usrptr(esp) 		|| !is_valid_usrptr(esp + 1) ||
-			 	!is_valid_usrptr(esp + 2) || !is_valid_usrptr(esp + 3))
+	//Let the MMU check the number and the arguments while copying
+	thread_current ()->user_esp = f->esp;
+	if (!copy_in (args, f->esp, sizeof args))
 		exit(-1);
 
 	switch(*esp) {
@@ -140,6 +221,14 @@ syscall_handler (struct intr_frame *f UNUSED)
 		case SYS_CLOSE: 					close 		(*(esp + 1)); 																break;
 		case SYS_MMAP:		*eax	= mmap 			(*(esp + 1), (void*) *(esp+2));								break;
 		case SYS_MUNMAP:  					munmap	  (*(esp + 1));																	break;
+		case SYS_VMSTAT:	*eax	= vmstat		((struct vmstat*) *(esp + 1));								break;
+		case SYS_SCHEDSTAT:*eax	= schedstat	((struct sched_thread_stat*) *(esp + 1),
+																				 (struct sched_event*) *(esp + 2), *(esp + 3)); break;
+		case SYS_SUBMIT:	*eax	= submit		((struct ring*) *(esp + 1), *(esp + 2));			break;
+		case SYS_PREAD:		*eax	= pread			(*(esp + 1), (void*) *(esp + 2), *(esp + 3), arg4 (f)); break;
+		case SYS_PWRITE:	*eax	= pwrite		(*(esp + 1), (void*) *(esp + 2), *(esp + 3), arg4 (f)); break;
+		case SYS_READV:		*eax	= readv			(*(esp + 1), (struct iovec*) *(esp + 2), *(esp + 3)); break;
+		case SYS_WRITEV:	*eax	= writev		(*(esp + 1), (struct iovec*) *(esp + 2), *(esp + 3)); break;
 		default:																																					exit (-1);
 	}
 }
@@ -157,7 +246,7 @@ exit (int status)
 	struct thread *current = thread_current ();
 	if (current->mmf != NULL)
 		munmap ((mapid_t)current->mmf);
-	current->child_status = status;
+	current->exit_status = status;
 	thread_exit ();
 }
 
@@ -167,10 +256,15 @@ exit (int status)
 static pid_t
 exec (const char *file)
 {
-	if ( !is_valid_usrptr(file)) 
+	char *kfile = copy_in_string (file);
+	pid_t pid;
+
+	if (kfile == NULL)
 		exit(-1);
 
-	return process_execute(file);
+	pid = process_execute(kfile);
+	palloc_free_page (kfile);
+	return pid;
 }
 
 /*
@@ -185,191 +279,173 @@ wait (pid_t p UNUSED)
 static bool
 create (const char *file, unsigned initial_size)
 {
-	if ( !is_valid_usrptr(file)) 
+	char *kfile = copy_in_string (file);
+	bool out;
+
+	if (kfile == NULL)
 		exit(-1);
 
-	lock_acquire(&my_lock);
-		bool out = filesys_create( file, initial_size);	
-	lock_release(&my_lock);
+	out = filesys_create( kfile, initial_size);
+	palloc_free_page (kfile);
 	return out;
 }
 
 static bool
 remove (const char *file)
 {
-	if (!is_valid_usrptr(file)) 
+	char *kfile = copy_in_string (file);
+	bool out;
+
+	if (kfile == NULL)
 		exit(-1);
 
-	lock_acquire(&my_lock);
-		bool out = filesys_remove(file);
-	lock_release(&my_lock);
+	out = filesys_remove(kfile);
+	palloc_free_page (kfile);
 	return out;
 }
 
 static int
 open (const char *file)
 {
-	if (!is_valid_usrptr(file))
-		exit(-1);
-
-	struct file_attr *f;
-	lock_acquire(&my_lock);
-
-	f = calloc(1, sizeof(struct file_attr));
-	f->file = filesys_open(file);
-
-	if (f->file == NULL)
-		goto exit;
-
-	f->fd = get_new_fd();
-	f->holder = thread_current()->tid;
-	list_push_back(&opened_files, &f->elem);
+	char *kfile = copy_in_string (file);
+	struct file *f;
+	int fd = -1;
 
-	lock_release(&my_lock);
+	if (kfile == NULL)
+		exit(-1);
 
-	return f->fd;
+	f = filesys_open(kfile);
+	if (f != NULL && (fd = fd_alloc(f)) < 0)
+		file_close(f);
 
-exit:
-	free(f);
-	lock_release(&my_lock);
-	return -1;
+	palloc_free_page (kfile);
+	return fd;
 }
 
 static int
 filesize (int fd)
 {
-	struct file_attr *f;
+	struct file *f;
 	if (NULL == (f = fdtofile(fd)))
 		return -1;
 	else 
-		return file_length(f->file);
+		return file_length(f);
 }
 
+/*
+	Read from the keyboard or from a file through file_io
+*/
 static int 
 read (int fd, void *buffer, unsigned length)
 {
-	struct file_attr *f;
-	unsigned i = 0;
-	unsigned buf_s = length;
-	off_t bytes_readed;
-	struct thread *t = thread_current();
-	struct frame *fr;
-	struct page* pg;
-	void* buf;
-
-	//It will allocate all the pages needed to read the file
-	for (buf = buffer; buf != NULL;) {
-		if (!is_user_vaddr(buf))
-			exit(-1);
+	struct file *f;
+	uint8_t *ubuf = buffer;
+	unsigned done;
 
-		pg = pageTable_find (pg_round_down (buf));
-		if (pagedir_get_page (t->pagedir, buf) == NULL) {
-			if ((buf >= (my_esp - 32)) && pg == NULL)
-				if (NULL != (fr = frameTable_alloc ()))
-					pagedir_set_page (t->pagedir, pg_round_down (buf), fr->kaddr, true);	
-				else
-					exit(-1);
-			else 
-				exit (-1);
-		}
-		if (buf_s == 0)
-			buf = NULL;
-
-		else if (buf_s > PGSIZE) {
-			buf += PGSIZE;
-			buf_s -= PGSIZE;
-		} else {
-			buf = buffer + length- 1;
-			buf_s = 0;
-		}
-	}
-
-	lock_acquire (&my_lock);
 	switch (fd) {
 		case STDIN_FILENO:	
-			for (	i = 0; i < length; i++) 
-				((uint8_t*) buffer) [i] = input_getc();
+			for (	done = 0; done < length; done++) 
+				if (!is_user_vaddr (ubuf + done) || !put_user (ubuf + done, input_getc()))
+					exit(-1);
 
-			lock_release (&my_lock);
 			return (int)length;
 
 		case STDOUT_FILENO:
-			lock_release (&my_lock);
 			return -1;
 
 		default:
-			if (NULL == (f = fdtofile(fd))) {
-				lock_release (&my_lock);
+			if (NULL == (f = fdtofile(fd)))
 				return -1;
 
-			} else {
-				bytes_readed = file_read (f->file, buffer, length);
-				lock_release (&my_lock);
-			}
-			return bytes_readed;
+			return file_io (f, ubuf, length, -1, true);
 	}
 }
 
+/*
+	Write to the console or to a file through file_io
+*/
 	static int
 write (int fd, const void *buffer, unsigned length)
 {
-	struct file_attr *f;
-	struct thread *t;
-	struct page *p;
-	off_t bytes_writted;
+	struct file *f = NULL;
 
-	if (!is_valid_usrptr(buffer) || !is_valid_usrptr(buffer+length))
-		exit(-1);
+	mmf_forget_writes (fd);
+	if (fd == STDIN_FILENO || (fd != STDOUT_FILENO && NULL == (f = fdtofile(fd))))
+		return -1;
 
-	t = thread_current();
-	if (t->mmf != NULL && fd > 2){
-		p = pageTable_find (t->mmf);
-		p->writted = false;
-	}
-	lock_acquire(&my_lock);
-	switch (fd) {
-		case STDOUT_FILENO:	
-			putbuf(buffer, length);
-			lock_release(&my_lock);
-			return length;
+	return file_io (f, (uint8_t *) buffer, length, -1, false);
+}
 
-		case STDIN_FILENO:
-			lock_release(&my_lock);
-			return -1;
+/*
+	Move LENGTH bytes between the user buffer and F, at offset OFS,
+	or at the file position when OFS is negative. The pages of the
+	user buffer are pinned a window at a time while the file system
+	works on them, so it never faults on user memory while it holds
+	its locks. A NULL F writes to the console
+*/
+static int
+file_io (struct file *f, uint8_t *ubuf, unsigned length, off_t ofs, bool reading)
+{
+	unsigned done = 0;
+	off_t chunk, n;
 
-		default:
-			if ( NULL == (f = fdtofile(fd))) {
-				lock_release(&my_lock);
-				return -1;
+	while (done < length) {
+		chunk = length - done < IO_WINDOW ? length - done : IO_WINDOW;
+		if (!frameTable_pin_buffer (ubuf + done, chunk, reading))
+			exit(-1);
 
-			} else {
-				bytes_writted = file_write(f->file, buffer, length);
-				lock_release(&my_lock);
-				return bytes_writted;
-			}
+		if (f == NULL) {
+			putbuf((const char *) ubuf + done, chunk);
+			n = chunk;
+		} else if (reading)
+			n = ofs < 0 ? file_read (f, ubuf + done, chunk)
+				: file_read_at (f, ubuf + done, chunk, ofs + done);
+		else
+			n = ofs < 0 ? file_write (f, ubuf + done, chunk)
+				: file_write_at (f, ubuf + done, chunk, ofs + done);
+		frameTable_unpin_buffer (ubuf + done, chunk);
+
+		done += n;
+		if (n < chunk)
+			break;
+	}
+	return done;
+}
+
+/*
+	A write through a file descriptor means the mmapped page
+	of the process must not be written back on munmap
+*/
+static void
+mmf_forget_writes (int fd)
+{
+	struct thread *t = thread_current();
+	struct page *p;
+
+	if (t->mmf != NULL && fd > 2){
+		p = pageTable_find (t->mmf);
+		p->writted = false;
 	}
 }
 
 	static void
 seek (int fd, unsigned position)
 {
-	struct file_attr *f;
+	struct file *f;
 	if (NULL == (f = fdtofile(fd)))
 		exit(-1);
 
-	lock_acquire(&my_lock);
-	file_seek(f->file, position);
-	lock_release(&my_lock);
+	file_seek(f, position);
 }
 
 	static unsigned
 tell (int fd)
 {
-	struct file_attr *f;
+	struct file *f;
 	if (NULL == (f = fdtofile(fd)))
 		exit(-1);
 
-	return file_tell(f->file);
+	return file_tell(f);
 }
 
 	static void
@@ -384,14 +460,9 @@ close (int fd)
 			*(uint32_t*)last_mmap = 123123;
 			pagedir_clear_page (t->pagedir, last_mmap);
 		}
-		struct file_attr *f;
-		if ( NULL != (f = fdtofile(fd))) {
-			lock_acquire(&my_lock);
-			file_close(f->file);
-			list_remove(&f->elem);
-			free(f);
-			lock_release(&my_lock);
-		}
+		struct file *f;
+		if ( NULL != (f = fd_remove(fd)))
+			file_close(f);
 	}
 }
 
@@ -406,7 +477,7 @@ close (int fd)
 static mapid_t
 mmap (int fd, void *addr)
 {
-	struct file_attr *f;
+	struct file *f;
 	int length;
 	int ofs = 0;
 	struct thread *t;
@@ -416,7 +487,7 @@ mmap (int fd, void *addr)
 	if (addr == NULL || addr == 0x0 || fd == 0 || fd == 1)
 		return -1;
 	
-	if (addr != pg_round_down (addr) || is_valid_usrptr(addr))
+	if (addr != pg_round_down (addr))
 		return -1;
 		
 	f = fdtofile (fd);
@@ -426,8 +497,8 @@ mmap (int fd, void *addr)
 	if (f == NULL)
 		return -1;
 
-	length = file_length (f->file);
-	if (length == 0)
+	length = file_length (f);
+	if (length == 0 || mmap_overlaps (addr, length))
 		return -1;
 	
 	t = thread_current ();
@@ -435,12 +506,13 @@ mmap (int fd, void *addr)
 
 	//Create the empty pages for the later lazy loading
 	while (ofs < length)	{
-		f->file = file_reopen (f->file);
-		pg = pageTable_insert_mmf (addr + ofs, f->file, ofs, true);
+		//Every page keeps its own reference to the file
+		f = file_reopen (f);
+		pg = pageTable_insert_mmf (addr + ofs, f, ofs, true);
 
 		if(!pg) 
 			return -1;
-		pg->file = f->file;
+		pg->file = f;
 		pg->ofs = ofs;
 		if (length - ofs > PGSIZE)	{
 			pg->read_bytes = PGSIZE;
@@ -465,25 +537,249 @@ munmap (mapid_t mapid)
 	void *addr = (void*) mapid;
 	struct page *pg;
 	struct thread *t;
+	struct inode *inode;
+	size_t cnt, i;
 
 	t = thread_current();
 	pg = pageTable_find (addr);
-	pg->file = file_reopen (pg->file);
+	if (pg == NULL || pg->type != mmf_page)
+		return;
+	inode = file_get_inode (pg->file);
+
+	//The mapping ends where the pages stop following its file, so an
+	//adjacent mapping (even of the same file) is left alone
+	for (cnt = 0; pg != NULL && pg->type == mmf_page
+			&& pg->ofs == (off_t) (cnt * PGSIZE)
+			&& file_get_inode (pg->file) == inode;
+			pg = pageTable_find (addr + ++cnt * PGSIZE)) {
+		//If we have to write to the disk, the dirty bit is lost once
+		//the PTE is cleared. A page out in the swap is faulted back in
+		if (pg->writted == true && (pagedir_is_dirty (t->pagedir, pg->uaddr)
+				|| (pg->frame == NULL && (pg->status & (swapped | compressed))))){
+			uint64_t start = vmstat_start ();
+			file_seek (pg->file, pg->ofs);
+			file_write (pg->file, pg->uaddr, pg->read_bytes);
+			vmstat_record (VMSTAT_WRITEBACK, start);
+		}
+	}
 
-	//If we have to write to the disk
-	if (pg->writted == true){
-		file_seek (pg->file, pg->ofs);
-		file_write (pg->file, pg->uaddr, pg->read_bytes);
+	//Unmap the whole mapping with a single TLB flush
+	pagedir_clear_pages (t->pagedir, addr, cnt);
 
-		addr += PGSIZE;
+	//Give back the frames and drop the pages of the mapping
+	for (i = 0; i < cnt; i++) {
+		pg = pageTable_find (addr + i * PGSIZE);
+		file_close (pg->file);
 		pageTable_delete (pg);
 	}
-		
-	//reset all the values
 	t->mmf = NULL;
-	file_close(pg->file);
-	pg->status |= loaded;
-	pagedir_clear_page (t->pagedir, pg->uaddr);
 	fd_by_mmap = 0;
 	last_mmap = (void*)mapid;
 }
+
+/*
+	Copy the VM statistics to the user buffer, one entry at
+	a time because the copy can page fault
+*/
+static bool
+vmstat (struct vmstat *buf)
+{
+	struct vmstat_entry e;
+	int type;
+
+	if (buf == NULL)
+		exit(-1);
+
+	for (type = 0; type < VMSTAT_CNT; type++) {
+		vmstat_get (type, &e);
+		if (!copy_out (&buf->entries[type], &e, sizeof e))
+			exit(-1);
+	}
+	return true;
+}
+
+/*
+	Copy the scheduler accounting of the current thread to SELF
+	and the last MAX context switches to EVENTS, both can be NULL.
+	Return the number of events copied
+*/
+static int
+schedstat (struct sched_thread_stat *self, struct sched_event *events, int max)
+{
+	struct sched_thread_stat stat;
+	struct sched_event *buf;
+	int n;
+
+	if (self != NULL) {
+		thread_get_sched_stat (&stat);
+		if (!copy_out (self, &stat, sizeof stat))
+			exit(-1);
+	}
+
+	if (events == NULL || max <= 0)
+		return 0;
+	if (max > SCHED_TRACE_SIZE)
+		max = SCHED_TRACE_SIZE;
+
+	//Copy through the kernel, the copy to the user can page fault
+	if (NULL == (buf = malloc (max * sizeof *buf)))
+		return -1;
+	n = thread_get_sched_trace (buf, max);
+	if (!copy_out (events, buf, n * sizeof *buf)) {
+		free (buf);
+		exit(-1);
+	}
+	free (buf);
+	return n;
+}
+
+/*
+	Run up to CNT entries of the submission queue of RING, in
+	order, and post one completion for each. Stop early when the
+	completion queue is full. The ring is user memory, so it is
+	read and written through copy_in and copy_out like any other
+	argument. Return the number of entries run
+*/
+static int
+submit (struct ring *ring, unsigned cnt)
+{
+	struct ring_sqe sqe;
+	struct ring_cqe cqe;
+	unsigned sq_head, sq_tail, cq_head, cq_tail;
+	unsigned done;
+
+	if (!copy_in (&sq_head, &ring->sq_head, sizeof sq_head)
+			|| !copy_in (&sq_tail, &ring->sq_tail, sizeof sq_tail)
+			|| !copy_in (&cq_head, &ring->cq_head, sizeof cq_head)
+			|| !copy_in (&cq_tail, &ring->cq_tail, sizeof cq_tail))
+		exit(-1);
+
+	for (done = 0; done < cnt && sq_head != sq_tail
+			&& cq_tail - cq_head < RING_SIZE; done++) {
+		if (!copy_in (&sqe, &ring->sq[sq_head & RING_MASK], sizeof sqe))
+			exit(-1);
+
+		cqe.user_data = sqe.user_data;
+		cqe.res = submit_one (&sqe);
+		if (!copy_out (&ring->cq[cq_tail & RING_MASK], &cqe, sizeof cqe))
+			exit(-1);
+
+		sq_head++;
+		cq_tail++;
+	}
+
+	//Publish the new indices once for the whole batch
+	if (!copy_out (&ring->sq_head, &sq_head, sizeof sq_head)
+			|| !copy_out (&ring->cq_tail, &cq_tail, sizeof cq_tail))
+		exit(-1);
+	return done;
+}
+
+/*
+	Run one submission like the system call of the same name,
+	bad pointers and file descriptors end the process the same way
+*/
+static int
+submit_one (const struct ring_sqe *sqe)
+{
+	switch (sqe->op) {
+		case RING_READ:		return read (sqe->fd, sqe->buf, sqe->len);
+		case RING_WRITE:	return write (sqe->fd, sqe->buf, sqe->len);
+		case RING_SEEK:		seek (sqe->fd, sqe->len);											return 0;
+		case RING_OPEN:		return open (sqe->buf);
+		case RING_CLOSE:	close (sqe->fd);															return 0;
+		default:					return -1;
+	}
+}
+
+/*
+	Fetch the fourth argument, only the system calls which
+	take four have it on the user stack
+*/
+static int32_t
+arg4 (struct intr_frame *f)
+{
+	int32_t arg;
+
+	if (!copy_in (&arg, (int32_t *) f->esp + 4, sizeof arg))
+		exit(-1);
+	return arg;
+}
+
+/*
+	Read from a file at OFFSET, the file position does not move
+*/
+static int
+pread (int fd, void *buffer, unsigned length, unsigned offset)
+{
+	struct file *f;
+
+	if ((off_t) offset < 0 || NULL == (f = fdtofile(fd)))
+		return -1;
+
+	return file_io (f, buffer, length, offset, true);
+}
+
+/*
+	Write to a file at OFFSET, the file position does not move
+*/
+static int
+pwrite (int fd, const void *buffer, unsigned length, unsigned offset)
+{
+	struct file *f;
+
+	mmf_forget_writes (fd);
+	if ((off_t) offset < 0 || NULL == (f = fdtofile(fd)))
+		return -1;
+
+	return file_io (f, (uint8_t *) buffer, length, offset, false);
+}
+
+/*
+	Read into each buffer of IOV in turn, stop at the first one
+	which is not filled. The vector is copied in at once
+*/
+static int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+	struct iovec v[IOV_MAX];
+	int i, n, total = 0;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX)
+		return -1;
+	if (!copy_in (v, iov, iovcnt * sizeof *v))
+		exit(-1);
+
+	for (i = 0; i < iovcnt; i++) {
+		if ((n = read (fd, v[i].iov_base, v[i].iov_len)) < 0)
+			return -1;
+		total += n;
+		if ((unsigned) n < v[i].iov_len)
+			break;
+	}
+	return total;
+}
+
+/*
+	Same as readv, but writing
+*/
+static int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+	struct iovec v[IOV_MAX];
+	int i, n, total = 0;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX)
+		return -1;
+	if (!copy_in (v, iov, iovcnt * sizeof *v))
+		exit(-1);
+
+	for (i = 0; i < iovcnt; i++) {
+		if ((n = write (fd, v[i].iov_base, v[i].iov_len)) < 0)
+			return -1;
+		total += n;
+		if ((unsigned) n < v[i].iov_len)
+			break;
+	}
+	return total;
+}
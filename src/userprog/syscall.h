@@ -4,6 +4,6 @@
 
 void syscall_init (void);
 void exit (int);
-inline bool is_valid_usrptr (const void*);
+void fd_close_all (void);
 
 #endif /* userprog/syscall.h */
@@ -1,7 +1,9 @@
 #include "userprog/tss.h"
 #include <debug.h>
 #include <stddef.h>
+#include <sysenter.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -75,6 +77,13 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* True if system calls can also come in through SYSENTER, which
+   takes its stack pointer from an MSR instead of the TSS. */
+static bool sysenter_enabled;
+
+/* SYSENTER entry point, in userprog/sysenter.S. */
+void sysenter_entry (void);
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -85,6 +94,15 @@ tss_init (void)
   tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
+
+  /* The user system call stubs make the same test before they
+     use SYSENTER. */
+  sysenter_enabled = sysenter_supported ();
+  if (sysenter_enabled)
+    {
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+    }
   tss_update ();
 }
 
@@ -96,11 +114,13 @@ tss_get (void)
   return tss;
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
-   of the thread stack. */
+/* Sets the ring 0 stack pointer in the TSS, and the SYSENTER
+   stack pointer, to point to the end of the thread stack. */
 void
 tss_update (void) 
 {
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  if (sysenter_enabled)
+    wrmsr (MSR_SYSENTER_ESP, (uint32_t) tss->esp0);
 }
@@ -0,0 +1,92 @@
+#include "userprog/uaccess.h"
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Returns true if the SIZE bytes at UADDR are all below
+   PHYS_BASE. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+
+  return start + size >= start && start + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Bounds of the fixup table, set by the linker script. */
+extern const struct uaccess_fixup _start_uaccess_fixups[];
+extern const struct uaccess_fixup _end_uaccess_fixups[];
+
+/* Returns the address at which to resume after the instruction
+   at EIP faulted on an invalid user address, or a null pointer if
+   EIP is not in one of the accessors. */
+void *
+uaccess_fixup (const void *eip)
+{
+  const struct uaccess_fixup *e;
+
+  for (e = _start_uaccess_fixups; e < _end_uaccess_fixups; e++)
+    if (e->insn == (uintptr_t) eip)
+      return (void *) e->fixup;
+  return NULL;
+}
+
+/* Copies SIZE bytes from SRC to DST with a single string move.
+   One of them is in user memory.  Returns false if the copy
+   faulted on an invalid user address, in which case page_fault()
+   resumes at label 2 with ECX bytes left to copy. */
+static bool
+user_copy (void *dst, const void *src, size_t size)
+{
+  asm volatile ("1: rep movsb; 2:\n\t"
+                UACCESS_FIXUP ("1b", "2b")
+                : "+D" (dst), "+S" (src), "+c" (size)
+                : : "eax", "memory");
+  return size == 0;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if USRC is not valid
+   user memory. */
+bool
+copy_in (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && user_copy (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if UDST is not valid
+   writable user memory. */
+bool
+copy_out (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && user_copy (udst, src, size);
+}
+
+/* Copies the null-terminated string at user address US into a
+   new page, which the caller must free with palloc_free_page().
+   Returns a null pointer if US is not valid user memory, if the
+   string does not fit in a page or if no page is available. */
+char *
+copy_in_string (const char *us)
+{
+  char *ks;
+  size_t i;
+
+  ks = palloc_get_page (0);
+  if (ks == NULL)
+    return NULL;
+
+  for (i = 0; i < PGSIZE; i++)
+    {
+      int c;
+
+      if (!is_user_vaddr (us + i) || (c = get_user ((const uint8_t *) us + i)) < 0)
+        break;
+      ks[i] = c;
+      if (c == '\0')
+        return ks;
+    }
+  palloc_free_page (ks);
+  return NULL;
+}
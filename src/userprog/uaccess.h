@@ -0,0 +1,69 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Access to user memory from the kernel.
+
+   These let the MMU check the user addresses instead of walking
+   the page directory first.  If an access faults on a page that
+   is swapped out or not loaded yet, page_fault() brings it in and
+   the access goes on.  If the address is invalid, page_fault()
+   looks the faulting instruction up in the table of fixups that
+   the accessors build with UACCESS_FIXUP, resumes execution at
+   its fixup address with EAX set to -1, and the accessor reports
+   failure.  A fault on a bad user address anywhere else still
+   kills the process.
+
+   Only user addresses, below PHYS_BASE, may be passed.  See
+   "Accessing User Memory" in the reference guide. */
+
+/* An entry of the fixup table: if the instruction at INSN faults
+   on an invalid user address, execution resumes at FIXUP. */
+struct uaccess_fixup
+  {
+    uintptr_t insn;
+    uintptr_t fixup;
+  };
+
+/* Assembly that adds an entry for instruction INSN and fixup
+   address FIXUP, both assembler labels, to the fixup table. */
+#define UACCESS_FIXUP(INSN, FIXUP)                      \
+        ".pushsection .uaccess_fixups, \"a\"\n\t"       \
+        ".long " INSN ", " FIXUP "\n\t"                  \
+        ".popsection\n\t"
+
+void *uaccess_fixup (const void *eip);
+
+/* Reads a byte at user virtual address UADDR.
+   Returns the byte value if successful, -1 if a segfault
+   occurred. */
+static inline int
+get_user (const uint8_t *uaddr)
+{
+  int result;
+  asm ("1: movzbl %1, %0; 2:\n\t"
+       UACCESS_FIXUP ("1b", "2b")
+       : "=&a" (result) : "m" (*uaddr));
+  return result;
+}
+
+/* Writes BYTE to user address UDST.
+   Returns true if successful, false if a segfault occurred. */
+static inline bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+  int error_code;
+  asm ("movl $0, %0; 1: movb %b2, %1; 2:\n\t"
+       UACCESS_FIXUP ("1b", "2b")
+       : "=&a" (error_code), "=m" (*udst) : "q" (byte));
+  return error_code != -1;
+}
+
+bool copy_in (void *dst, const void *usrc, size_t size);
+bool copy_out (void *udst, const void *src, size_t size);
+char *copy_in_string (const char *us);
+
+#endif /* userprog/uaccess.h */
@@ -3,7 +3,9 @@
 #include "threads/malloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/pte.h"
 #include "userprog/pagedir.h"
+#include "userprog/uaccess.h"
 #include <string.h> 
 #include <stdio.h> 
 
@@ -12,7 +14,13 @@ static bool frame_valid (struct frame*);
 static struct frame* frameTable_next_free (void);
 static struct frame* frameTable_evict (void);
 static struct frame* frameTable_next_evict (void);
-static void frameTable_add_frame (struct frame*);
+static void frameTable_evict_page (struct thread*, void*, void*);
+static void frameTable_add_frame (struct frame*, bool);
+static struct frame* frameTable_get (bool);
+static bool frameTable_pin (const uint8_t*, bool);
+static void frameTable_set_pinned (const void*, bool);
+static void* zeroPool_get (void);
+static void zeroPool_thread (void*);
 
 static struct frameTable ft;
 
@@ -27,9 +35,11 @@ frameTable_init (void)
 	int i;
 	for (i = 0; i < FT_SIZE; i++) {
 		ft.table[i].busy = false;
+		ft.table[i].pinned = false;
+		ft.table[i].large = false;
 		ft.table[i].kaddr = NULL;
 	}	
-	lock_init (&ft.ft_lock);
+	rwlock_init (&ft.ft_lock);
 	lock_init (&ft.ft_evict_lock);
 	lock_init (&ft.swap_lock);
 
@@ -37,6 +47,15 @@ frameTable_init (void)
 	ft.swap_block = block_get_role (BLOCK_SWAP);
 	ft.swap_bitmap = bitmap_create (block_size (ft.swap_block)/8);
 	bitmap_set_all (ft.swap_bitmap, true);
+
+	zswap_init ();
+
+	//Zero pages: one shared page for reads and a pool for writes
+	ft.zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	ft.zero_cnt = 0;
+	lock_init (&ft.zero_lock);
+	sema_init (&ft.zero_sema, 1);
+	thread_create ("zeroer", PRI_MIN, zeroPool_thread, NULL);
 }
 
 
@@ -47,21 +66,47 @@ frameTable_init (void)
 */
 struct frame*
 frameTable_alloc (void)
+{
+	return frameTable_get (false);
+}
+
+/*
+		Same that the above function but the page of the
+		frame is filled with zeros, it is taken from the
+		pool of the zeroing thread when possible
+*/
+struct frame*
+frameTable_alloc_zero (void)
+{
+	return frameTable_get (true);
+}
+
+
+/*
+		Take a slot for a 4 MB page: PTSPAN bytes of zeroed user
+		memory, aligned to PTSPAN so that a single PDE maps them.
+		Nothing is evicted to make room, return NULL if the user
+		pool has no such block or the table has no free slot
+*/
+struct frame*
+frameTable_alloc_large (void)
 {
 	struct frame* f;
-	if (NULL == (f = frameTable_next_free ())) {
-		frameTable_evict(); 
-		f = frameTable_next_free ();
-		frameTable_add_frame (f); 
 
-	} else {
-		ASSERT (frame_valid (f));
-		frameTable_add_frame (f); 
+	if (NULL == (f = frameTable_next_free ()))
+		return NULL;
+
+	f->kaddr = palloc_get_aligned (PAL_USER | PAL_ZERO, PTSPAN / PGSIZE, PTSPAN);
+	if (f->kaddr == NULL) {
+		frameTable_free (f);
+		return NULL;
 	}
+	f->large = true;
+	f->pinned = false;
+	f->tid = thread_current ()->tid;
 	return f;
 }
 
-
 /*
 		This function free the page of the given frame,
 		and initialize all the elements of the frame		
@@ -70,12 +115,82 @@ void
 frameTable_free (struct frame* f)
 {
 	ASSERT (frame_valid (f));	
-	lock_acquire (&ft.ft_lock);
+	rwlock_acquire_write (&ft.ft_lock);
 	
 	f->uaddr = f->kaddr = f->page = NULL;
  	f->tid = 0; 
 	f->busy = false;
-	lock_release (&ft.ft_lock);
+	f->pinned = false;
+	f->large = false;
+	rwlock_release_write (&ft.ft_lock);
+}
+
+/*
+		Give back the slots of the frames of the given thread, which
+		is exiting. Its pages themselves are freed with its page
+		directory. The eviction lock keeps the clock from choosing
+		one of them meanwhile
+*/
+void
+frameTable_free_thread (int tid)
+{
+	int i;
+
+	lock_acquire (&ft.ft_evict_lock);
+	rwlock_acquire_write (&ft.ft_lock);
+	for (i = 0; i < FT_SIZE; i++)
+		if (ft.table[i].busy && ft.table[i].tid == tid) {
+			ft.table[i].uaddr = ft.table[i].kaddr = ft.table[i].page = NULL;
+			ft.table[i].tid = 0;
+			ft.table[i].busy = false;
+			ft.table[i].pinned = false;
+			ft.table[i].large = false;
+		}
+	rwlock_release_write (&ft.ft_lock);
+	lock_release (&ft.ft_evict_lock);
+}
+
+/*
+		Fault in every page of the user buffer of the given size,
+		for writing if the flag is set, and pin their frames so
+		the eviction leaves them alone. The file system can then
+		work on the buffer without faulting while it holds its
+		locks. Return false, with nothing pinned, if the buffer is
+		not valid user memory. Keep the buffers small, the pinned
+		frames are out of the reach of eviction until unpinned
+*/
+bool
+frameTable_pin_buffer (const void* buffer, size_t size, bool write)
+{
+	const uint8_t* start = pg_round_down (buffer);
+	const uint8_t* end = (const uint8_t*) buffer + size;
+	const uint8_t* upage;
+
+	if (size == 0)
+		return true;
+	if (end < (const uint8_t*) buffer || end > (const uint8_t*) PHYS_BASE)
+		return false;
+
+	//Touch the buffer itself in its first page, the start of the
+	//page may be below the stack pointer
+	for (upage = start; upage < end; upage += PGSIZE)
+		if (!frameTable_pin (upage > start ? upage : buffer, write)) {
+			if (upage > start)
+				frameTable_unpin_buffer (start, upage - start);
+			return false;
+		}
+	return true;
+}
+
+/* Unpin the pages pinned by frameTable_pin_buffer */
+void
+frameTable_unpin_buffer (const void* buffer, size_t size)
+{
+	const uint8_t* upage = pg_round_down (buffer);
+	const uint8_t* end = (const uint8_t*) buffer + size;
+
+	for (; upage < end; upage += PGSIZE)
+		frameTable_set_pinned (upage, false);
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -90,16 +205,23 @@ frame_valid (struct frame* f) {
 }
 
 
-/* return if the frame is not null true */
+/* Find a free slot and mark it busy, so nobody else takes it */
 struct frame*
 frameTable_next_free (void)
 {
+	struct frame* f = NULL;
 	int i;
+
+	rwlock_acquire_write (&ft.ft_lock);
 	for (i = 0; i < FT_SIZE; i++)
-		if (ft.table[i].busy == false)
-			return &ft.table[i];
+		if (ft.table[i].busy == false) {
+			f = &ft.table[i];
+			f->busy = true;
+			break;
+		}
+	rwlock_release_write (&ft.ft_lock);
 
-	return NULL;
+	return f;
 }
 
 
@@ -109,83 +231,206 @@ frameTable_evict (void)
 {
 	struct frame* f;
 	struct thread* t;
-	struct page* p;
+	uint64_t start;
+	size_t i;
 
 	lock_acquire (&ft.ft_evict_lock);
+	start = vmstat_start ();
 
 	//Swap out the given frame
 	if (NULL == (f = frameTable_next_evict ()))
 		printf("No frames to be evict \n");
 
 	t = tid_to_thread (f->tid);
-	if (NULL == (p = pageTable_find (f->uaddr))) {
-		p = pageTable_insert_light (f->uaddr);
-	}
-
-	p->frame = NULL;
-	p->block = swap_out (p);
-	p->status |= swapped;
-	pagedir_clear_page (t->pagedir, p->uaddr);
-	palloc_free_page (f->kaddr);
+	if (f->large) {
+		//Back to 4 kB pages, which go out one by one
+		if (!pagedir_split_large_page (t->pagedir, f->uaddr))
+			PANIC ("no kernel page to split a 4 MB page");
+		for (i = 0; i < PTSPAN / PGSIZE; i++)
+			frameTable_evict_page (t, (uint8_t*) f->uaddr + i * PGSIZE,
+					(uint8_t*) f->kaddr + i * PGSIZE);
+	} else
+		frameTable_evict_page (t, f->uaddr, f->kaddr);
 
 	//Reset the given element
 	f->page = NULL;
 	f->busy = false;
+	f->large = false;
 	f->tid = 0;
 	f->kaddr = NULL;
+	vmstat_record (VMSTAT_EVICT, start);
 	
 	lock_release (&ft.ft_evict_lock);
 	return f;
 }
 
 
+/*
+		Move the user page at the given address of the given thread,
+		held in the given kernel page, to the compressed cache or to
+		the swap, unmap it and free its kernel page
+*/
+static void
+frameTable_evict_page (struct thread* t, void* uaddr, void* kaddr)
+{
+	struct page* p;
+	uint64_t out;
+
+	if (NULL == (p = pageTable_find (uaddr))) {
+		p = pageTable_insert_light (uaddr);
+	}
+
+	//Try the compressed cache before going to the disk
+	p->frame = NULL;
+	out = vmstat_start ();
+	if (zswap_store (p, kaddr)) {
+		p->status |= compressed;
+		vmstat_record (VMSTAT_ZSWAP_OUT, out);
+	} else {
+		p->block = swap_out (p);
+		p->status |= swapped;
+		vmstat_record (VMSTAT_SWAP_OUT, out);
+	}
+	pagedir_clear_page (t->pagedir, p->uaddr);
+	palloc_free_page (kaddr);
+}
+
 /* return if the frame is not null true */
 struct frame*
 frameTable_next_evict (void)
 {
 	int i,j;
-	lock_acquire (&ft.ft_lock);
+
+	//The clock only reads the table, evictions are serialized by ft_evict_lock
+	rwlock_acquire_read (&ft.ft_lock);
 	for (j = 0; j < 2; j++) {
 		for (i = 0; i < FT_SIZE; i++) {
-			struct thread *t = tid_to_thread (ft.table[i].tid);
+			struct thread *t;
+
+			//Pinned by a system call which is using it, or taken by
+			//frameTable_next_free and not filled in yet
+			if (ft.table[i].pinned || ft.table[i].kaddr == NULL
+					|| ft.table[i].uaddr == NULL
+					|| NULL == (t = tid_to_thread (ft.table[i].tid))
+					|| t->pagedir == NULL)
+				continue;
 
 			if (!pagedir_is_accessed (t->pagedir, ft.table[i].uaddr)) {
-				lock_release (&ft.ft_lock);
+				rwlock_release_read (&ft.ft_lock);
 				return &ft.table[i];
 			}else 
 				pagedir_set_accessed (t->pagedir, ft.table[i].uaddr, false);
 		}
 	}
-	lock_release (&ft.ft_lock);
+	rwlock_release_read (&ft.ft_lock);
 	return NULL;
 }
 
 
+/* Find a slot (evicting if needed) and give it a page */
+struct frame*
+frameTable_get (bool zero)
+{
+	struct frame* f;
+	if (NULL == (f = frameTable_next_free ())) {
+		frameTable_evict(); 
+		f = frameTable_next_free ();
+		frameTable_add_frame (f, zero); 
+
+	} else {
+		ASSERT (frame_valid (f));
+		frameTable_add_frame (f, zero); 
+	}
+	return f;
+}
+
 /* return if the frame is not null true */
 void 
-frameTable_add_frame (struct frame* f)
+frameTable_add_frame (struct frame* f, bool zero)
 {
-	if (NULL == (	f->kaddr = palloc_get_page (PAL_USER))) {
-		frameTable_evict();
-		if (NULL == (	f->kaddr = palloc_get_page (PAL_USER))) {
-			printf("NO solution\n"); }
-	
+	if (zero && NULL != (f->kaddr = zeroPool_get ())) {
+		//already zeroed, zeroPool_get wakes up the zeroing thread
+
+	} else if (NULL == (	f->kaddr = palloc_get_page (PAL_USER))) {
+		//The pool is our last reserve before evicting
+		if (NULL == (f->kaddr = zeroPool_get ())) {
+			frameTable_evict();
+			if (NULL == (	f->kaddr = palloc_get_page (PAL_USER))) {
+				printf("NO solution\n"); }
+		}
+
+	} else if (zero) {
+		memset (f->kaddr, 0, PGSIZE);
 	}
 	f->busy = true;
+	f->pinned = false;
 	f->tid = thread_current ()->tid;
 }
 
+/*
+	Fault in the user page of the given address and pin its
+	frame. The page can be evicted again between the touch and
+	the pin, so try until it is still there under the eviction
+	lock. Pages without a frame, like the shared zero page, are
+	never evicted
+*/
+bool
+frameTable_pin (const uint8_t* uaddr, bool write)
+{
+	struct thread* t = thread_current ();
+	struct frame* f;
+	uint8_t* kaddr;
+	int byte;
+
+	for (;;) {
+		//Writing the byte back breaks copy on write, like the user would
+		if ((byte = get_user (uaddr)) < 0
+				|| (write && !put_user ((uint8_t*) uaddr, byte)))
+			return false;
+
+		lock_acquire (&ft.ft_evict_lock);
+		kaddr = pagedir_get_page (t->pagedir, pg_round_down (uaddr));
+		if (kaddr != NULL) {
+			if (NULL != (f = frameTable_find_by_kaddr (kaddr)))
+				f->pinned = true;
+			lock_release (&ft.ft_evict_lock);
+			return true;
+		}
+		lock_release (&ft.ft_evict_lock);
+	}
+}
+
+/* Set the pinned flag of the frame of the given user page */
+void
+frameTable_set_pinned (const void* upage, bool pinned)
+{
+	struct frame* f;
+	uint8_t* kaddr = pagedir_get_page (thread_current ()->pagedir, upage);
+
+	if (kaddr != NULL && NULL != (f = frameTable_find_by_kaddr (kaddr)))
+		f->pinned = pinned;
+}
+
 /*Given a kernel address return the 
 	frame which point to it */
 struct frame*
 frameTable_find_by_kaddr (uint8_t* kaddr) 
 {
+	struct frame* f = NULL;
 	int i;
+
+	rwlock_acquire_read (&ft.ft_lock);
 	for (i = 0; i < FT_SIZE; i++)
-		if (ft.table[i].kaddr == kaddr)
-			return &ft.table[i];
+		if (ft.table[i].kaddr == kaddr
+				|| (ft.table[i].large && ft.table[i].kaddr != NULL
+					&& kaddr > (uint8_t*) ft.table[i].kaddr
+					&& kaddr < (uint8_t*) ft.table[i].kaddr + PTSPAN)) {
+			f = &ft.table[i];
+			break;
+		}
+	rwlock_release_read (&ft.ft_lock);
 
-	return NULL;
+	return f;
 }
 
 /*
@@ -201,6 +446,9 @@ swap_in (struct page* p)
 
 	if (!pagedir_set_page (thread_current ()->pagedir, p->uaddr, p->frame->kaddr, true))
 		printf ("ERROR Swapping in\n");
+	//A mapped file page in the swap may differ from the file
+	if (p->type == mmf_page)
+		pagedir_set_dirty (thread_current ()->pagedir, p->uaddr, true);
 
 	for (i = 0; i < SECTOR_PAGE; i++)
 		block_read 
@@ -243,3 +491,57 @@ void
 swap_delete (size_t index) {
 	bitmap_flip (ft.swap_bitmap, index);
 }
+
+/* Return the shared page of zeros, it must be mapped read-only */
+void*
+frameTable_zero_page (void)
+{
+	return ft.zero_page;
+}
+
+/* Take a pre-zeroed page from the pool, NULL if it is empty */
+void*
+zeroPool_get (void)
+{
+	void* kpage = NULL;
+
+	lock_acquire (&ft.zero_lock);
+	if (ft.zero_cnt > 0)
+		kpage = ft.zero_pool[--ft.zero_cnt];
+	lock_release (&ft.zero_lock);
+
+	//the zeroing thread refills the slot we took
+	if (kpage != NULL)
+		sema_up (&ft.zero_sema);
+	return kpage;
+}
+
+/*
+	Background thread which keeps the pool full of zeroed
+	pages, so page faults on stack and bss do not have to
+	clear the page themselves. It stops refilling when the
+	user pool is exhausted and waits to be woken up again.
+*/
+void
+zeroPool_thread (void* aux UNUSED)
+{
+	void* kpage;
+
+	for (;;) {
+		sema_down (&ft.zero_sema);
+		while (ft.zero_cnt < ZERO_POOL_SIZE
+				&& NULL != (kpage = palloc_get_page (PAL_USER))) {
+			memset (kpage, 0, PGSIZE);
+
+			lock_acquire (&ft.zero_lock);
+			if (ft.zero_cnt < ZERO_POOL_SIZE) {
+				ft.zero_pool[ft.zero_cnt++] = kpage;
+				kpage = NULL;
+			}
+			lock_release (&ft.zero_lock);
+
+			if (kpage != NULL)
+				palloc_free_page (kpage);
+		}
+	}
+}
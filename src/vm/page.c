@@ -26,6 +26,7 @@ pageTable_insert_light (void *addr)
 	p->status = 0;
 	p->uaddr = addr;
 	p->block = 0;
+	p->zentry = NULL;
 	p->frame = NULL;
 
 	hash_insert (&t->pageTable, &p->h_elem);
@@ -50,6 +51,7 @@ pageTable_insert (void *addr)
 	p->status = 0;
 	p->uaddr = addr;
 	p->block = 0;
+	p->zentry = NULL;
 	p->frame = frameTable_alloc ();
 
 	hash_insert (&t->pageTable, &p->h_elem);
@@ -74,6 +76,8 @@ pageTable_insert_file (void *uaddr, struct file *file,
 	p->status = 0;
 	p->uaddr = uaddr;
 	p->block = 0;
+	p->zentry = NULL;
+	p->frame = NULL;
 
 	p->file = file;
 	p->ofs  = ofs;
@@ -105,6 +109,7 @@ pageTable_insert_mmf (void *uaddr, struct file *file,
 	p->writted = false;
 	p->uaddr = uaddr;
 	p->block = 0;
+	p->zentry = NULL;
 
 	p->file = file;
 	p->ofs  = ofs;
@@ -116,15 +121,55 @@ pageTable_insert_mmf (void *uaddr, struct file *file,
 	return p;
 }
 
-/* Delete the given page */
+/*
+	This function create a new entry in the hash table of zero type,
+	used by bss and stack pages. Reading it maps the shared zero
+	page and the first write gives it its own frame (page fault)
+*/
+struct page* 
+pageTable_insert_zero (void *uaddr, bool writable)
+{
+	struct page *p;
+	struct thread* t = thread_current();
+	p = malloc (sizeof (struct page));
+
+	p->type = zero_page;
+	p->status = 0;
+	p->writted = false;
+	p->uaddr = uaddr;
+	p->block = 0;
+	p->zentry = NULL;
+	p->frame = NULL;
+
+	p->file = NULL;
+	p->ofs  = 0;
+	p->read_bytes = 0;
+	p->zero_bytes = PGSIZE;
+	p->writable = writable;
+	hash_insert (&t->pageTable, &p->h_elem);
+
+	return p;
+}
+
+/*
+	Delete the given page: give back its frame, or its slot in the
+	swap or in the compressed cache, and free it. It must not be
+	mapped anymore
+*/
 void
 pageTable_delete (struct page *p)
 {
 	struct thread* t = thread_current();
- 	if (p->frame == NULL)	
-		printf("PAGE TABLE DELETE ERROR\n");
-	frameTable_free (p->frame);
+
+	if (p->frame != NULL) {
+		palloc_free_page (p->frame->kaddr);
+		frameTable_free (p->frame);
+	} else if (p->status & compressed)
+		zswap_delete (p);
+	else if (p->status & swapped)
+		swap_delete (p->block);
 	hash_delete (&t->pageTable, &p->h_elem); 
+	free (p);
 }
 
 /* Given a user address return the page 
@@ -171,12 +216,14 @@ comp_va_page (const struct hash_elem *hea, const struct hash_elem *heb,
 	return pga->uaddr < pgb->uaddr;
 }
 
-/* In case that the page is swapped, delete that slot*/
+/* In case that the page is swapped or compressed, delete that slot*/
 void
 page_hash_delete (struct hash_elem* hea, void* aux UNUSED) 
 {
 	struct page* p = hash_entry (hea, struct page, h_elem);
-	if (p->status & swapped)
+	if (p->status & compressed)
+		zswap_delete (p);
+	else if (p->status & swapped)
 		swap_delete (p->block);		
 
 	free (p);
@@ -8,9 +8,11 @@
 #include "threads/vaddr.h"
 #include "devices/block.h"
 #include "filesys/off_t.h"
+#include <vmstat.h>
 
 #define FT_SIZE 380
 #define SECTOR_PAGE PGSIZE/BLOCK_SECTOR_SIZE
+#define ZERO_POOL_SIZE 16
 
 ////////////////////////////////////////////////////////////////////
 // Function regarding virtual memory															//
@@ -39,6 +41,8 @@ void virtualMemory_init (void);
 
 struct frame {
 	bool busy;
+	bool pinned;										/* Must not be evicted */
+	bool large;											/* 4 MB page, PTSPAN bytes at kaddr */
 	int tid;
 	void* kaddr;
 	void* uaddr;
@@ -46,7 +50,7 @@ struct frame {
 };
 
 struct frameTable {
-	struct lock ft_lock;
+	struct rwlock ft_lock;						/* Protects table, mostly read */
 	struct lock ft_evict_lock;
 	struct lock swap_lock;
 
@@ -54,19 +58,85 @@ struct frameTable {
 	struct bitmap* swap_bitmap;
 	struct block* swap_block;
 	int cont;
+
+	void* zero_page;								/* Shared read-only zero page */
+	void* zero_pool [ZERO_POOL_SIZE];		/* Pre-zeroed user pages */
+	int zero_cnt;
+	struct lock zero_lock;
+	struct semaphore zero_sema;			/* Wakes up the zeroing thread */
 };
 
 void frameTable_init (void); 						//constructor
 struct frame* frameTable_alloc (void);  
+struct frame* frameTable_alloc_zero (void);
+struct frame* frameTable_alloc_large (void);
 void frameTable_free (struct frame*);  
+void frameTable_free_thread (int);
 struct frame* frameTable_find_by_kaddr (uint8_t*);
 
+//Functions regarding pinning user buffers during a system call
+bool frameTable_pin_buffer (const void*, size_t, bool);
+void frameTable_unpin_buffer (const void*, size_t);
+
 struct page;
 //Functions regarding swapping
 void swap_in (struct page*);
 size_t swap_out (struct page*);
 void swap_delete (size_t);
 
+//Functions regarding zero pages
+void* frameTable_zero_page (void);
+
+
+////////////////////////////////////////////////////////////////////
+// ADT: COMPRESSED SWAP CACHE (zswap)															//
+// DATA STRUCTURES: kernel pages holding two compressed pages each	//
+//									(zbud), list of pages with a free half				//
+//																																//
+// Evicted pages are compressed with lzf and kept in RAM, the		//
+// pool is capped at ZSWAP_PERCENT of the kernel pool. Pages which	//
+// do not compress to half a page, or do not fit, go to the swap	//
+// block device as before.																				//
+////////////////////////////////////////////////////////////////////
+
+#define ZSWAP_PERCENT 20
+
+struct zbud {
+	struct list_elem elem;			/* Element in the unbuddied list */
+	uint8_t* kpage;							/* Kernel page with the data */
+	size_t first;								/* Length at the start of the page */
+	size_t last;								/* Length at the end of the page */
+};
+
+struct zswap_entry {
+	struct zbud* bud;						/* Page which holds the data */
+	bool last;									/* At the end of that page? */
+	size_t len;									/* Compressed length */
+};
+
+void zswap_init (void);
+bool zswap_store (struct page*, const void*);
+bool zswap_load (struct page*);
+void zswap_delete (struct page*);
+
+
+////////////////////////////////////////////////////////////////////
+// ADT: VM STATISTICS																							//
+// DATA STRUCTURES: counters and log2 latency histograms in TSC		//
+//									cycles per kind of event (lib/vmstat.h)				//
+//																																//
+// HOW TO USE: 																										//
+//	uint64_t start = vmstat_start ();															//
+//	...																														//
+//	vmstat_record (VMSTAT_SWAP_IN, start);												//
+//																																//
+////////////////////////////////////////////////////////////////////
+
+uint64_t vmstat_start (void);
+void vmstat_record (enum vmstat_type, uint64_t);
+void vmstat_get (enum vmstat_type, struct vmstat_entry*);
+void vmstat_print (void);
+
 
 ////////////////////////////////////////////////////////////////////
 // ADT: SUPLEMENTAL PAGE TABLE																		//
@@ -84,8 +154,8 @@ void swap_delete (size_t);
 ////////////////////////////////////////////////////////////////////
 
 
-enum page_type {normal = 1, file_page = 2, mmf_page = 3};
-enum page_status {loaded = 2, swapped = 2};
+enum page_type {normal = 1, file_page = 2, mmf_page = 3, zero_page = 4};
+enum page_status {loaded = 2, swapped = 2, compressed = 4};
 
 struct page {
 	enum page_type type;
@@ -95,6 +165,7 @@ struct page {
 	struct frame* frame;
 	void* uaddr;
 	size_t block;
+	struct zswap_entry* zentry;
 
 	struct file *file;
 	off_t ofs;
@@ -110,6 +181,7 @@ struct page* pageTable_insert_light (void*);
 struct page* pageTable_insert_file (void*,
 	 struct file*, off_t, uint32_t, uint32_t, bool);
 struct page* pageTable_insert_mmf (void *, struct file *, off_t, bool);
+struct page* pageTable_insert_zero (void *, bool);
 
 void pageTable_delete (struct page*);
 struct page* pageTable_find (void*);
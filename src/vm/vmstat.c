@@ -0,0 +1,86 @@
+#include "vm/virtualMemory.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include <inttypes.h>
+#include <stdio.h>
+
+static const char* vmstat_names [VMSTAT_CNT] = {
+	"stack growth", "file load", "zero fill", "mmap load", "swap in",
+	"zswap in", "evict", "swap out", "zswap out", "writeback"
+};
+
+//Updated with interrupts off, page faults can be nested
+static struct vmstat stats;
+
+/*
+		Return the time stamp to give to vmstat_record when the
+		event is over
+*/
+uint64_t
+vmstat_start (void)
+{
+	return rdtsc ();
+}
+
+/*
+		Count one event of the given type which began at START
+*/
+void
+vmstat_record (enum vmstat_type type, uint64_t start)
+{
+	struct vmstat_entry* e = &stats.entries[type];
+	uint64_t cycles = rdtsc () - start;
+	uint32_t low = cycles;
+	int bucket = VMSTAT_BUCKETS - 1;
+	enum intr_level old_level;
+
+	//log2 of the cycles, without 64 bit helpers
+	if (cycles >> 32 == 0)
+		bucket = low != 0 ? 31 - __builtin_clz (low) : 0;
+	if (bucket >= VMSTAT_BUCKETS)
+		bucket = VMSTAT_BUCKETS - 1;
+
+	old_level = intr_disable ();
+	e->count++;
+	e->cycles += cycles;
+	if (cycles > e->max)
+		e->max = cycles;
+	e->hist[bucket]++;
+	intr_set_level (old_level);
+}
+
+/*
+		Copy the statistics of the given type into E
+*/
+void
+vmstat_get (enum vmstat_type type, struct vmstat_entry* e)
+{
+	enum intr_level old_level = intr_disable ();
+	*e = stats.entries[type];
+	intr_set_level (old_level);
+}
+
+/*
+		Print the counters, and the latency histogram of every
+		event which happened, at shutdown
+*/
+void
+vmstat_print (void)
+{
+	struct vmstat_entry e;
+	int type, i;
+
+	for (type = 0; type < VMSTAT_CNT; type++) {
+		vmstat_get (type, &e);
+		if (e.count == 0)
+			continue;
+
+		printf ("VM: %s: %llu events, %llu cycles avg, %llu max\n",
+				vmstat_names[type], e.count, e.cycles / e.count, e.max);
+		printf ("VM:  ");
+		for (i = 0; i < VMSTAT_BUCKETS; i++)
+			if (e.hist[i] != 0)
+				printf (" 2^%d:%"PRIu32, i, e.hist[i]);
+		printf ("\n");
+	}
+}
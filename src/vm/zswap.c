@@ -0,0 +1,176 @@
+#include "vm/virtualMemory.h"
+#include "threads/palloc.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include <lzf.h>
+#include <string.h>
+#include <stdio.h>
+
+static void zbud_release (struct zbud*, bool);
+
+static struct lock zswap_lock;
+static struct list unbuddied;				/* zbud pages with a free half */
+static size_t zswap_pages;					/* kernel pages in the pool */
+static size_t zswap_max_pages;			/* cap of the pool */
+
+//Scratch buffers, protected by zswap_lock
+static uint8_t zswap_work [LZF_WORK_SIZE];
+static uint8_t zswap_buf [PGSIZE / 2];
+
+/*
+		Initialize the compressed cache, its size is a 
+		fraction of the kernel pool
+*/
+void
+zswap_init (void)
+{
+	lock_init (&zswap_lock);
+	list_init (&unbuddied);
+	zswap_pages = 0;
+	zswap_max_pages = palloc_page_cnt (0) * ZSWAP_PERCENT / 100;
+}
+
+/*
+		Compress the page KADDR of the given page into the pool.
+		Return false if it does not compress well enough or the
+		pool is full, then the caller must use the swap disk.
+*/
+bool
+zswap_store (struct page* p, const void* kaddr)
+{
+	struct zswap_entry* e;
+	struct zbud* bud = NULL;
+	size_t len;
+
+	if (NULL == (e = malloc (sizeof (struct zswap_entry))))
+		return false;
+
+	lock_acquire (&zswap_lock);
+	len = lzf_compress (kaddr, PGSIZE, zswap_buf, sizeof zswap_buf, zswap_work);
+	if (len == 0)
+		goto fail;
+
+	//First try to fill the free half of a page
+	if (!list_empty (&unbuddied)) {
+		bud = list_entry (list_front (&unbuddied), struct zbud, elem);
+		if (bud->first + bud->last + len > PGSIZE)
+			bud = NULL;
+	}
+
+	if (bud == NULL) {
+		if (zswap_pages >= zswap_max_pages)
+			goto fail;
+		if (NULL == (bud = malloc (sizeof (struct zbud))))
+			goto fail;
+		if (NULL == (bud->kpage = palloc_get_page (0))) {
+			free (bud);
+			goto fail;
+		}
+		bud->first = bud->last = 0;
+		list_push_back (&unbuddied, &bud->elem);
+		zswap_pages++;
+	}
+
+	e->bud = bud;
+	e->len = len;
+	if (bud->first == 0) {
+		e->last = false;
+		bud->first = len;
+		memcpy (bud->kpage, zswap_buf, len);
+	} else {
+		e->last = true;
+		bud->last = len;
+		memcpy (bud->kpage + PGSIZE - len, zswap_buf, len);
+	}
+
+	if (bud->first != 0 && bud->last != 0)
+		list_remove (&bud->elem);
+	lock_release (&zswap_lock);
+
+	p->zentry = e;
+	return true;
+
+fail:
+	lock_release (&zswap_lock);
+	free (e);
+	return false;
+}
+
+/*
+		Given a compressed page, allocate a frame, decompress
+		the data into it and map it again (like swap_in)
+*/
+bool
+zswap_load (struct page* p)
+{
+	struct zswap_entry* e = p->zentry;
+	uint8_t* src;
+	size_t len;
+
+	ASSERT (e != NULL);
+	p->frame = frameTable_alloc ();
+
+	lock_acquire (&zswap_lock);
+	src = e->last ? e->bud->kpage + PGSIZE - e->len : e->bud->kpage;
+	len = lzf_decompress (src, e->len, p->frame->kaddr, PGSIZE);
+	lock_release (&zswap_lock);
+
+	if (len != PGSIZE) {
+		printf ("zswap: corrupted page at %p\n", p->uaddr);
+		frameTable_free (p->frame);
+		return false;
+	}
+
+	if (!pagedir_set_page (thread_current ()->pagedir, p->uaddr, p->frame->kaddr, true)) {
+		frameTable_free (p->frame);
+		return false;
+	}
+	//A mapped file page in the cache may differ from the file
+	if (p->type == mmf_page)
+		pagedir_set_dirty (thread_current ()->pagedir, p->uaddr, true);
+
+	zswap_delete (p);
+	p->status = loaded;
+	return true;
+}
+
+/* Drop the compressed copy of the given page */
+void
+zswap_delete (struct page* p)
+{
+	struct zswap_entry* e = p->zentry;
+
+	if (e == NULL)
+		return;
+
+	lock_acquire (&zswap_lock);
+	zbud_release (e->bud, e->last);
+	lock_release (&zswap_lock);
+
+	free (e);
+	p->zentry = NULL;
+}
+
+/* Free one half of BUD, and the whole page if both are free */
+void
+zbud_release (struct zbud* bud, bool last)
+{
+	bool was_full = bud->first != 0 && bud->last != 0;
+
+	if (last)
+		bud->last = 0;
+	else
+		bud->first = 0;
+
+	if (bud->first == 0 && bud->last == 0) {
+		if (!was_full)
+			list_remove (&bud->elem);
+		palloc_free_page (bud->kpage);
+		free (bud);
+		zswap_pages--;
+
+	} else if (was_full) {
+		list_push_front (&unbuddied, &bud->elem);
+	}
+}